@@ -0,0 +1,193 @@
+/*
+ *  HKCommandQueue.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_COMMAND_QUEUE_H__)
+#define HK_COMMAND_QUEUE_H__ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace hk {
+
+/*
+ Multiple producers, single consumer queue (D. Vyukov's intrusive MPSC queue).
+
+ push() never blocks nor waits for other producers: it is a single atomic exchange (plus the node
+ allocation). pop() must only be called by the consumer. It may return false while a producer is
+ between its two steps, in which case the value is returned by a later call.
+ */
+template<class T>
+class MPSCQueue {
+public:
+  MPSCQueue() : _head(&_stub), _tail(&_stub) {}
+  MPSCQueue(const MPSCQueue &) = delete;
+  MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+  ~MPSCQueue() {
+    T value;
+    while (pop(value)) {}
+  }
+
+  void push(T value) {
+    __Push(new Node(std::move(value)));
+  }
+
+  bool pop(T &value) {
+    Link *tail = _tail;
+    Link *next = tail->next.load(std::memory_order_acquire);
+    if (tail == &_stub) {
+      if (!next)
+        return false;
+      _tail = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+    if (!next) {
+      /* tail is the last node: a producer may be linking a new one */
+      if (tail != _head.load(std::memory_order_acquire))
+        return false;
+      __Push(&_stub);
+      next = tail->next.load(std::memory_order_acquire);
+      if (!next)
+        return false;
+    }
+    _tail = next;
+    Node *node = static_cast<Node *>(tail);
+    value = std::move(node->value);
+    delete node;
+    return true;
+  }
+
+private:
+  struct Link {
+    std::atomic<Link *> next { nullptr };
+  };
+
+  struct Node : Link {
+    explicit Node(T &&v) : value(std::move(v)) {}
+    T value;
+  };
+
+  void __Push(Link *link) {
+    link->next.store(nullptr, std::memory_order_relaxed);
+    Link *previous = _head.exchange(link, std::memory_order_acq_rel);
+    previous->next.store(link, std::memory_order_release);
+  }
+
+  Link _stub;
+  std::atomic<Link *> _head;
+  Link *_tail; // consumer only
+};
+
+/*
+ Commands submitted from any thread, and executed in batches on the thread that owns the
+ resource they apply to.
+
+ Submitting never blocks. When a command is submitted to an idle queue, the wakeup function
+ is called (on the submitting thread) and must schedule drain() on the owner thread. drain()
+ executes all pending commands in submission order, then completes them (fulfills their future,
+ or calls their completion, on the owner thread).
+ */
+template<class Command, class Result>
+class CommandQueue {
+public:
+  typedef std::function<void(const Result &result)> Completion;
+
+  explicit CommandQueue(std::function<void()> wakeup) : _wakeup(std::move(wakeup)) {}
+  CommandQueue(const CommandQueue &) = delete;
+  CommandQueue &operator=(const CommandQueue &) = delete;
+
+  std::future<Result> submit(Command command) {
+    Entry entry { std::move(command), std::promise<Result>(), nullptr };
+    std::future<Result> future = entry.promise->get_future();
+    __Submit(std::move(entry));
+    return future;
+  }
+
+  /* completion may be null */
+  void submit(Command command, Completion completion) {
+    __Submit(Entry { std::move(command), std::nullopt, std::move(completion) });
+  }
+
+  /*
+   Owner thread only, not reentrant. execute(Command &) returns the command result.
+   Executes at most limit commands. If more commands are pending, wakeup is called again.
+   Returns the number of commands executed.
+   */
+  template<class Execute>
+  size_t drain(Execute &&execute, size_t limit = SIZE_MAX) {
+    /* commands submitted from now on must wake the owner again */
+    _scheduled.store(false);
+
+    Entry entry;
+    while (_batch.size() < limit && _queue.pop(entry))
+      _batch.push_back(std::move(entry));
+    size_t count = _batch.size();
+    if (!count)
+      return 0;
+    for (Entry &pending : _batch)
+      _results.push_back(execute(pending.command));
+    /* before completing, so a waiting thread sees the statistics of its batch */
+    _batches.store(_batches.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    _executed.store(_executed.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+
+    for (size_t idx = 0; idx < _batch.size(); idx++) {
+      Entry &done = _batch[idx];
+      if (done.promise)
+        done.promise->set_value(_results[idx]);
+      else if (done.completion)
+        done.completion(_results[idx]);
+    }
+    /* releases the commands, but keeps the storage */
+    _batch.clear();
+    _results.clear();
+    /* limit reached: there may be commands left */
+    if (count == limit && !_scheduled.exchange(true))
+      _wakeup();
+    return count;
+  }
+
+  /* Non empty batches drained, and commands executed (may be read from any thread) */
+  uint64_t batches() const { return _batches.load(std::memory_order_relaxed); }
+  uint64_t executed() const { return _executed.load(std::memory_order_relaxed); }
+
+private:
+  struct Entry {
+    Command command;
+    std::optional<std::promise<Result>> promise; // only for submit() returning a future
+    Completion completion;
+  };
+
+  void __Submit(Entry &&entry) {
+    _queue.push(std::move(entry));
+    if (!_scheduled.exchange(true))
+      _wakeup();
+  }
+
+  MPSCQueue<Entry> _queue;
+  std::atomic<bool> _scheduled { false };
+  std::function<void()> _wakeup;
+
+  /* owner thread only (reused, so draining does not allocate once warmed up) */
+  std::vector<Entry> _batch;
+  std::vector<Result> _results;
+  /* written by the owner thread only */
+  std::atomic<uint64_t> _batches { 0 };
+  std::atomic<uint64_t> _executed { 0 };
+};
+
+} // namespace hk
+
+#endif /* HK_COMMAND_QUEUE_H__ */
@@ -50,6 +50,67 @@ bool HKEventPostKeystrokeToTarget(HKKeycode keycode, HKModifier modifier, HKEven
 HK_EXPORT
 bool HKEventPostCharacterKeystrokesToTarget(UniChar character, HKEventTarget target, HKEventTargetType type, CGEventSourceRef source, CFIndex usLatency);
 
+// MARK: Target Handles
+typedef struct __HKEventTargetHandle *HKEventTargetHandleRef;
+
+/*!
+ @function
+ @abstract   Creates a handle that can be used to send events repeatedly to the same target.
+ @discussion Bundle targets are resolved on first use, and the result is cached until an application
+ with this bundle identifier is launched or terminated.
+ Events are sent through a private event source: system and process handles own theirs, while
+ all handles for the same bundle share the source of the cached target (and so its local event state).
+ @result     Returns a new handle that must be released using HKEventTargetHandleRelease().
+ */
+HK_EXPORT
+HKEventTargetHandleRef HKEventTargetHandleCreate(HKEventTarget target, HKEventTargetType type);
+
+HK_EXPORT
+void HKEventTargetHandleRelease(HKEventTargetHandleRef handle);
+
+/*!
+ @function
+ @abstract   Returns the pid of the process targeted by <i>handle</i>.
+ @result     Returns 0 for system target, or -1 if the target application is not running.
+ */
+HK_EXPORT
+pid_t HKEventTargetHandleGetProcessIdentifier(HKEventTargetHandleRef handle);
+
+HK_EXPORT
+bool HKEventPostKeystrokeToHandle(HKKeycode keycode, HKModifier modifier, HKEventTargetHandleRef handle, CFIndex usLatency);
+
+HK_EXPORT
+bool HKEventPostCharacterKeystrokesToHandle(UniChar character, HKEventTargetHandleRef handle, CFIndex usLatency);
+
+// MARK: Adaptive Pacing
+/*!
+ @abstract   Called periodically while posting events with adaptive pacing.
+ @result     Returns true if the target consumed all the events sent so far.
+ */
+typedef bool (^HKEventAcknowledgementProbe)(void);
+
+/*!
+ @function
+ @abstract   Enables adaptive pacing for the events sent through <i>handle</i>.
+ @discussion When enabled, the latency passed to the posting functions is ignored. The delay between two events
+ starts short, increases when the target lags (as reported by the probe) or drops events (as reported by
+ HKEventTargetHandleReportDroppedEvents()), and decreases again while the target keeps up.
+ The rate learned for a target is remembered, and used as starting rate by the next handles for the same target
+ (except for process targets, as pids are recycled).
+ Pacing state is not thread safe: a paced handle must be used by one thread at a time.
+ @param      probe May be nil. Without probe, the delay never decreases below the initial (or remembered) delay,
+ and increases when the target drops events.
+ */
+HK_EXPORT
+void HKEventTargetHandleSetAdaptivePacing(HKEventTargetHandleRef handle, bool adaptive, HKEventAcknowledgementProbe probe);
+
+/*!
+ @function
+ @abstract   Tells the pacer of <i>handle</i> that the target lost events (for instance, the text typed does not match the text sent).
+ */
+HK_EXPORT
+void HKEventTargetHandleReportDroppedEvents(HKEventTargetHandleRef handle, CFIndex count);
+
 @interface HKHotKey (HKEventExtension)
 
 - (BOOL)sendKeystroke:(CFIndex)latency;
@@ -0,0 +1,355 @@
+/*
+ *  HKEvent.m
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2004 - 2013 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#import "HKEvent.h"
+#import "HKKeyMap.h"
+
+#include "HKEventPacing.h"
+#include "HKEventTargetCache.h"
+#include "HKKeystroke.h"
+
+#include <time.h>
+#include <unistd.h>
+
+static pid_t _HKGetProcessWithBundleIdentifier(CFStringRef bundleId);
+static void _HKEventTargetHandlePace(HKEventTargetHandleRef handle);
+
+static_assert(hk::kKeycodeCommand == kHKVirtualCommandKey && hk::kKeycodeShift == kHKVirtualShiftKey &&
+              hk::kKeycodeCapsLock == kHKVirtualCapsLockKey && hk::kKeycodeOption == kHKVirtualOptionKey &&
+              hk::kKeycodeControl == kHKVirtualControlKey, "modifier keycodes mismatch");
+
+#pragma mark -
+HK_INLINE
+void __HKEventPostKeyboardEvent(CGEventSourceRef source, HKKeycode keycode, pid_t pid, bool down, CFIndex latency) {
+  CGEventRef event = CGEventCreateKeyboardEvent(source, keycode, down);
+  if (pid) {
+    if (kCFCoreFoundationVersionNumber >= kCFCoreFoundationVersionNumber10_11) {
+      CGEventPostToPid(pid, event);
+    } else {
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+      ProcessSerialNumber psn;
+      if (noErr == GetProcessForPID(pid, &psn)) {
+        CGEventPostToPSN(&psn, event);
+      }
+#pragma clang diagnostic pop
+    }
+  } else {
+    CGEventPost(kCGHIDEventTap, event);
+  }
+  CFRelease(event);
+  if (latency > 0) {
+    /* Avoid to fast typing (5 ms by default) */
+    usleep((useconds_t)latency);
+  } else if (latency < 0) {
+    CFRunLoopRunInMode(kCFRunLoopDefaultMode, -latency / 1e6, false);
+  }
+}
+
+/* pacing: handle with adaptive pacing enabled, latency is ignored */
+static
+void _HKEventPostKeyStroke(HKKeycode keycode, HKModifier modifier, CGEventSourceRef source, pid_t pid, CFIndex latency, HKEventTargetHandleRef pacing = NULL) {
+  /* WARNING: look like CGEvent does not support null source (bug) */
+  BOOL isource = NO;
+  if (!source) {
+    isource = YES;
+    source = HKEventCreatePrivateSource();
+  }
+
+  hk::PostKeystroke([=](uint16_t code, bool down) {
+    if (pacing)
+      _HKEventTargetHandlePace(pacing);
+    __HKEventPostKeyboardEvent(source, code, pid, down, pacing ? 0 : latency);
+  }, keycode, modifier);
+
+  if (isource && source) {
+    CFRelease(source);
+  }
+}
+
+static
+bool _HKEventPostCharacterKeystrokes(UniChar character, CGEventSourceRef source, pid_t pid, CFIndex latency, HKEventTargetHandleRef pacing = NULL) {
+  /* WARNING: look like CGEvent does not support null source (bug) */
+  BOOL isource = NO; /* YES if internal source and should be released */
+  if (!source) {
+    isource = YES;
+    source = HKEventCreatePrivateSource();
+  }
+
+  HKKeycode keys[8];
+  HKModifier mods[8];
+  NSUInteger count = [[HKKeyMap currentKeyMap] getKeycodes:keys modifiers:mods maxLength:8 forCharacter:character];
+  for (NSUInteger idx = 0; idx < count; idx++) {
+    _HKEventPostKeyStroke(keys[idx], mods[idx], source, pid, latency, pacing);
+  }
+
+  if (isource && source) {
+    CFRelease(source);
+  }
+
+  return count > 0;
+}
+
+#pragma mark API
+CGEventSourceRef HKEventCreatePrivateSource(void) {
+  return CGEventSourceCreate(kCGEventSourceStatePrivate);
+}
+
+void HKEventPostKeystroke(HKKeycode keycode, HKModifier modifier, CGEventSourceRef source, CFIndex latency) {
+  _HKEventPostKeyStroke(keycode, modifier, source, 0, latency);
+}
+
+bool HKEventPostCharacterKeystrokes(UniChar character, CGEventSourceRef source, CFIndex latency) {
+  return _HKEventPostCharacterKeystrokes(character, source, 0, latency);
+}
+
+HK_INLINE
+pid_t __HKEventGetPSNForTarget(HKEventTarget target, HKEventTargetType type) {
+  switch (type) {
+    case kHKEventTargetSystem:
+      return 0;
+    case kHKEventTargetProcess:
+      return target.pid;
+    case kHKEventTargetBundle:
+      return _HKGetProcessWithBundleIdentifier(target.bundle);
+  }
+  return -1;
+}
+
+bool HKEventPostKeystrokeToTarget(HKKeycode keycode, HKModifier modifier, HKEventTarget target, HKEventTargetType type, CGEventSourceRef source, CFIndex latency) {
+  pid_t pid = __HKEventGetPSNForTarget(target, type);
+  if (pid >= 0) {
+    _HKEventPostKeyStroke(keycode, modifier, source, pid, latency);
+    return YES;
+  }
+  return NO;
+}
+
+bool HKEventPostCharacterKeystrokesToTarget(UniChar character, HKEventTarget target, HKEventTargetType type, CGEventSourceRef source, CFIndex latency) {
+  pid_t pid = __HKEventGetPSNForTarget(target, type);
+  if (pid >= 0) {
+    _HKEventPostCharacterKeystrokes(character, source, pid, latency);
+    return YES;
+  }
+  return NO;
+}
+
+#pragma mark Target Handles
+struct HKEventTargetTraits {
+  typedef CGEventSourceRef Source;
+
+  static int32_t Resolve(const std::string &bundle) {
+    NSString *identifier = [[NSString alloc] initWithBytes:bundle.data() length:bundle.size() encoding:NSUTF8StringEncoding];
+    return _HKGetProcessWithBundleIdentifier(SPXNSToCFString(identifier));
+  }
+  static Source CreateSource() { return HKEventCreatePrivateSource(); }
+  static void ReleaseSource(Source source) { if (source) CFRelease(source); }
+};
+
+typedef hk::EventTargetCache<HKEventTargetTraits> HKEventTargetCache;
+
+struct __HKEventTargetHandle {
+  HKEventTargetType type;
+  pid_t pid;
+  /* source owned by the handle for system and process targets */
+  CGEventSourceRef source;
+  /* shared cache entry for bundle targets */
+  HKEventTargetCache::Target *target;
+  /* adaptive pacing (NULL if disabled) */
+  hk::KeystrokePacer *pacer;
+  HKEventAcknowledgementProbe probe;
+};
+
+static
+HKEventTargetCache &_HKEventTargetCacheGet(void) {
+  static HKEventTargetCache *sCache = nullptr;
+  static dispatch_once_t sOnce;
+  dispatch_once(&sOnce, ^{
+    sCache = new HKEventTargetCache();
+    /* Workspace notifications are always posted on the main thread */
+    NSNotificationCenter *center = NSWorkspace.sharedWorkspace.notificationCenter;
+    for (NSNotificationName name in @[NSWorkspaceDidLaunchApplicationNotification, NSWorkspaceDidTerminateApplicationNotification]) {
+      [center addObserverForName:name object:nil queue:nil usingBlock:^(NSNotification *notification) {
+        NSString *bundle = [notification.userInfo[NSWorkspaceApplicationKey] bundleIdentifier];
+        if (bundle)
+          sCache->invalidate(bundle.UTF8String);
+      }];
+    }
+  });
+  return *sCache;
+}
+
+HKEventTargetHandleRef HKEventTargetHandleCreate(HKEventTarget target, HKEventTargetType type) {
+  HKEventTargetHandleRef handle = new __HKEventTargetHandle();
+  handle->type = type;
+  switch (type) {
+    case kHKEventTargetSystem:
+      handle->source = HKEventCreatePrivateSource();
+      break;
+    case kHKEventTargetProcess:
+      handle->pid = target.pid;
+      handle->source = HKEventCreatePrivateSource();
+      break;
+    case kHKEventTargetBundle: {
+      NSString *bundle = SPXCFToNSString(target.bundle);
+      handle->target = _HKEventTargetCacheGet().acquire(bundle.UTF8String ? : "");
+    }
+      break;
+  }
+  return handle;
+}
+
+void HKEventTargetHandleRelease(HKEventTargetHandleRef handle) {
+  if (!handle)
+    return;
+  HKEventTargetHandleSetAdaptivePacing(handle, false, nil);
+  if (handle->target)
+    _HKEventTargetCacheGet().release(handle->target);
+  if (handle->source)
+    CFRelease(handle->source);
+  delete handle;
+}
+
+pid_t HKEventTargetHandleGetProcessIdentifier(HKEventTargetHandleRef handle) {
+  if (kHKEventTargetBundle == handle->type)
+    return _HKEventTargetCacheGet().resolve(handle->target);
+  return handle->pid;
+}
+
+HK_INLINE
+CGEventSourceRef __HKEventTargetHandleGetSource(HKEventTargetHandleRef handle) {
+  return handle->target ? handle->target->source() : handle->source;
+}
+
+bool HKEventPostKeystrokeToHandle(HKKeycode keycode, HKModifier modifier, HKEventTargetHandleRef handle, CFIndex latency) {
+  pid_t pid = HKEventTargetHandleGetProcessIdentifier(handle);
+  if (pid >= 0) {
+    _HKEventPostKeyStroke(keycode, modifier, __HKEventTargetHandleGetSource(handle), pid, latency, handle->pacer ? handle : NULL);
+    return YES;
+  }
+  return NO;
+}
+
+bool HKEventPostCharacterKeystrokesToHandle(UniChar character, HKEventTargetHandleRef handle, CFIndex latency) {
+  pid_t pid = HKEventTargetHandleGetProcessIdentifier(handle);
+  if (pid >= 0) {
+    _HKEventPostCharacterKeystrokes(character, __HKEventTargetHandleGetSource(handle), pid, latency, handle->pacer ? handle : NULL);
+    return YES;
+  }
+  return NO;
+}
+
+#pragma mark Adaptive Pacing
+static
+hk::PacingMemory &_HKEventPacingMemory(void) {
+  static auto *sMemory = new hk::PacingMemory();
+  return *sMemory;
+}
+
+/* Targets are remembered by bundle identifier. Pids are recycled, so process targets are not remembered (empty key) */
+static
+std::string _HKEventTargetHandlePacingKey(HKEventTargetHandleRef handle) {
+  switch (handle->type) {
+    case kHKEventTargetSystem:
+      return "system";
+    case kHKEventTargetProcess:
+      return std::string();
+    case kHKEventTargetBundle:
+      return handle->target->bundle();
+  }
+  return std::string();
+}
+
+static
+void _HKEventTargetHandleRememberPacing(HKEventTargetHandleRef handle) {
+  std::string key = _HKEventTargetHandlePacingKey(handle);
+  if (!key.empty())
+    _HKEventPacingMemory().remember(key, handle->pacer->state());
+}
+
+void HKEventTargetHandleSetAdaptivePacing(HKEventTargetHandleRef handle, bool adaptive, HKEventAcknowledgementProbe probe) {
+  if (handle->pacer) {
+    _HKEventTargetHandleRememberPacing(handle);
+    delete handle->pacer;
+    handle->pacer = NULL;
+  }
+  handle->probe = adaptive ? probe : nil;
+  if (adaptive) {
+    std::string key = _HKEventTargetHandlePacingKey(handle);
+    handle->pacer = new hk::KeystrokePacer(hk::PacingConfig(), key.empty() ? hk::PacingState() : _HKEventPacingMemory().lookup(key));
+  }
+}
+
+void HKEventTargetHandleReportDroppedEvents(HKEventTargetHandleRef handle, CFIndex count) {
+  if (handle->pacer && count > 0) {
+    handle->pacer->dropped((uint32_t)count);
+    _HKEventTargetHandleRememberPacing(handle);
+  }
+}
+
+/* Waits until the next event can be posted */
+void _HKEventTargetHandlePace(HKEventTargetHandleRef handle) {
+  hk::KeystrokePacer *pacer = handle->pacer;
+  if (pacer->probeDue()) {
+    if (!handle->probe)
+      pacer->unprobed();
+    else if (handle->probe())
+      pacer->acknowledged();
+    else
+      pacer->lagging();
+    _HKEventTargetHandleRememberPacing(handle);
+  }
+  uint64_t now = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+  uint64_t at = pacer->schedule(now);
+  if (at > now)
+    usleep((useconds_t)((at - now) / 1000));
+}
+
+#pragma mark -
+#pragma mark Statics Functions Definition
+pid_t _HKGetProcessWithBundleIdentifier(CFStringRef bundleId) {
+  NSRunningApplication *app = [[NSRunningApplication runningApplicationsWithBundleIdentifier:SPXCFToNSString(bundleId)] firstObject];
+  return app ? app.processIdentifier : -1;
+}
+
+#pragma mark -
+@implementation HKHotKey (HKEventExtension)
+
+- (BOOL)sendKeystroke:(CFIndex)latency {
+  if ([self isValid]) {
+    HKEventTarget target = {};
+    HKEventTargetType type = kHKEventTargetSystem;
+    if ([self isRegistred]) {
+      target.pid = [NSWorkspace.sharedWorkspace frontmostApplication].processIdentifier;
+      type = kHKEventTargetProcess;
+    }
+    HKEventPostKeystrokeToTarget(self.keycode, self.nativeModifier, target, type, NULL, latency);
+  } else {
+    return NO;
+  }
+  return YES;
+}
+
+- (BOOL)sendKeystrokeToApplication:(NSString *)bundleId latency:(CFIndex)latency {
+  BOOL result = NO;
+  if ([self isValid]) {
+    /* Find target and target type */
+    HKEventTarget target = {};
+    HKEventTargetType type = kHKEventTargetSystem;
+
+    if (bundleId) {
+      target.bundle = SPXNSToCFString(bundleId);
+      type = kHKEventTargetBundle;
+    }
+
+    result = HKEventPostKeystrokeToTarget(self.keycode, self.nativeModifier, target, type, NULL, latency);
+  }
+  return result;
+}
+
+@end
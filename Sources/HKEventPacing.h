@@ -0,0 +1,144 @@
+/*
+ *  HKEventPacing.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_EVENT_PACING_H__)
+#define HK_EVENT_PACING_H__ 1
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace hk {
+
+struct PacingConfig {
+  uint32_t initialDelay = 250; // µs between two events for an unknown target
+  uint32_t minDelay = 50; // µs
+  uint32_t maxDelay = 20000; // µs
+  /* events between two acknowledgements */
+  uint32_t probeInterval = 16;
+  /* consecutive acknowledgements before speeding up */
+  uint32_t speedupAfter = 4;
+};
+
+/* What is remembered about a target */
+struct PacingState {
+  uint32_t delay = 0; // µs, 0 means unknown target
+  uint32_t floor = 0; // µs, the delay never goes below it (0 means no drop observed)
+};
+
+/*
+ Adaptive keystroke pacing.
+
+ Replaces the fixed sleep after each event. The delay between two events starts short, and:
+ - decreases by 1/4 after speedupAfter consecutive acknowledgements (never below the floor, and never
+   for a target that cannot be probed),
+ - increases by 1/2 when the target lags (an acknowledgement probe reports pending events),
+ - doubles when the target drops events, and the floor is set a step above the delay that dropped.
+
+ The pacer has no clock: times are passed by the caller (nanoseconds), so it is deterministic
+ and can be driven by a virtual clock. It is not thread safe.
+ */
+class KeystrokePacer {
+public:
+  explicit KeystrokePacer(const PacingConfig &config = PacingConfig(), const PacingState &state = PacingState())
+    : _config(config), _floor(state.floor) {
+    _delay = __Clamp(state.delay ? state.delay : config.initialDelay);
+  }
+
+  /* Returns the time at which the next event must be posted (>= now) */
+  uint64_t schedule(uint64_t now) {
+    uint64_t at = _events ? std::max(now, _last + static_cast<uint64_t>(_delay) * 1000) : now;
+    _last = at;
+    _events++;
+    _pending++;
+    return at;
+  }
+
+  /* true when the target should be probed (or, without probe, marked unprobed) */
+  bool probeDue() const { return _pending >= _config.probeInterval; }
+
+  /* The target consumed all events sent so far */
+  void acknowledged() {
+    _pending = 0;
+    if (++_streak >= _config.speedupAfter) {
+      _streak = 0;
+      _delay = __Clamp(_delay - _delay / 4);
+    }
+  }
+
+  /* The target cannot be probed: nothing proves it keeps up, so the delay is not decreased */
+  void unprobed() {
+    _pending = 0;
+    _streak = 0;
+  }
+
+  /* The target has pending events */
+  void lagging() {
+    _pending = 0;
+    _streak = 0;
+    _lags++;
+    _delay = __Clamp(_delay + std::max(_delay / 2, 1U));
+  }
+
+  void dropped(uint32_t count) {
+    _pending = 0;
+    _streak = 0;
+    _drops += count;
+    /* the delay that dropped is not safe */
+    _floor = std::min(_config.maxDelay, _delay + std::max(_delay / 4, 1U));
+    _delay = __Clamp(_delay * 2);
+  }
+
+  uint32_t delay() const { return _delay; }
+  PacingState state() const { return { _delay, _floor }; }
+
+  uint64_t events() const { return _events; }
+  uint64_t drops() const { return _drops; }
+  uint64_t lags() const { return _lags; }
+
+private:
+  uint32_t __Clamp(uint32_t delay) const {
+    return std::min(_config.maxDelay, std::max({ delay, _config.minDelay, _floor }));
+  }
+
+  PacingConfig _config;
+  uint32_t _delay;
+  uint32_t _floor;
+  uint64_t _last = 0;
+  uint32_t _pending = 0;
+  uint32_t _streak = 0;
+  uint64_t _events = 0;
+  uint64_t _drops = 0;
+  uint64_t _lags = 0;
+};
+
+/* Pacing state per target, so a new pacer for a known target starts at its safe rate */
+class PacingMemory {
+public:
+  PacingState lookup(const std::string &target) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto iter = _states.find(target);
+    return iter != _states.end() ? iter->second : PacingState();
+  }
+
+  void remember(const std::string &target, const PacingState &state) {
+    std::lock_guard<std::mutex> lock(_lock);
+    _states[target] = state;
+  }
+
+private:
+  mutable std::mutex _lock;
+  std::unordered_map<std::string, PacingState> _states;
+};
+
+} // namespace hk
+
+#endif /* HK_EVENT_PACING_H__ */
@@ -0,0 +1,181 @@
+/*
+ *  HKEventReplay.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_EVENT_REPLAY_H__)
+#define HK_EVENT_REPLAY_H__ 1
+
+#include "HKEventTrace.h"
+
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace hk {
+
+/*
+ Repeat logic of a single hotkey.
+ This is the same state machine than HKHotKey keyPressed:/keyReleased:/hk_invoke:,
+ expressed in virtual time (nanoseconds) so it can run without run loop nor timer.
+ */
+class HotKeyRepeatModel {
+public:
+  explicit HotKeyRepeatModel(const TraceHotKey &desc) :
+    _initial(static_cast<uint64_t>(desc.initialRepeatInterval) * 1000),
+    _interval(static_cast<uint64_t>(desc.repeatInterval) * 1000),
+    _onrelease((desc.flags & kTraceHotKeyInvokeOnKeyUp) != 0) {}
+
+  /* Returns true if the hotkey is invoked */
+  bool pressed(uint64_t time) {
+    _down = true;
+    _next = 0;
+    _timer++;
+    if (_onrelease) {
+      _invoked = false;
+      return false;
+    }
+    _invoked = true;
+    if (_interval > 0 && _initial > 0)
+      _next = time + _initial;
+    return true;
+  }
+
+  bool released(uint64_t) {
+    _down = false;
+    _next = 0;
+    _timer++;
+    return _onrelease && !_invoked;
+  }
+
+  /* Fires the repeat timer. Returns false if the timer is no longer valid */
+  bool fire(uint64_t time, uint32_t timer) {
+    if (timer != _timer || !_next || time != _next)
+      return false;
+    _next += _interval;
+    return true;
+  }
+
+  bool isDown() const { return _down; }
+  /* 0 if no repeat is scheduled */
+  uint64_t nextRepeat() const { return _next; }
+  uint32_t timer() const { return _timer; }
+
+private:
+  uint64_t _initial;
+  uint64_t _interval;
+  uint64_t _next = 0;
+  /* incremented each time the repeat timer is invalidated */
+  uint32_t _timer = 0;
+  bool _onrelease;
+  bool _down = false;
+  bool _invoked = false;
+};
+
+struct ReplayStats {
+  uint64_t events = 0; // pressed and released records
+  uint64_t invocations = 0; // including repeats
+  uint64_t repeats = 0;
+  uint64_t recordedRepeats = 0; // repeats present in the trace
+  uint64_t unknown = 0; // records for undescribed hotkeys
+  uint64_t layoutChanges = 0;
+  uint64_t duration = 0; // virtual time elapsed (ns)
+};
+
+/*
+ Replays a trace on a virtual clock.
+
+ Pressed and released records drive the repeat models, and repeat timers are fired at their
+ due time, so a replay produces the invocations the dispatcher would have performed, as fast as
+ the CPU allows. Recorded repeats are not replayed, they are only counted, so they can be compared
+ with the computed ones.
+ Records must be sorted by time (as returned by TraceRecorder::stop()). Records sharing a
+ timestamp with a timer are processed before the timer (a key released exactly when a repeat
+ is due does not repeat).
+
+ Fn: void(uint32_t hotkey, uint64_t time, bool repeat), called for each invocation.
+ */
+template<class Fn>
+ReplayStats TraceReplay(const Trace &trace, Fn &&invoke) {
+  struct Timer {
+    uint64_t time;
+    size_t model;
+    uint32_t generation;
+    bool operator>(const Timer &other) const { return time > other.time; }
+  };
+
+  ReplayStats stats;
+  std::vector<HotKeyRepeatModel> models;
+  std::vector<uint32_t> ids;
+  std::unordered_map<uint32_t, size_t> index;
+  models.reserve(trace.hotkeys.size());
+  for (const TraceHotKey &desc : trace.hotkeys) {
+    if (index.emplace(desc.hotkey, models.size()).second) {
+      models.emplace_back(desc);
+      ids.push_back(desc.hotkey);
+    }
+  }
+
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+  auto schedule = [&](size_t idx) {
+    const HotKeyRepeatModel &model = models[idx];
+    if (model.nextRepeat())
+      timers.push({ model.nextRepeat(), idx, model.timer() });
+  };
+  auto fireUntil = [&](uint64_t time) {
+    while (!timers.empty() && timers.top().time < time) {
+      Timer timer = timers.top();
+      timers.pop();
+      if (models[timer.model].fire(timer.time, timer.generation)) {
+        stats.invocations++;
+        stats.repeats++;
+        invoke(ids[timer.model], timer.time, true);
+        schedule(timer.model);
+      }
+    }
+  };
+
+  if (trace.records.empty())
+    return stats;
+
+  uint64_t start = trace.records.front().time;
+  uint64_t last = start;
+  uint16_t epoch = trace.records.front().epoch;
+  for (const TraceRecord &record : trace.records) {
+    fireUntil(record.time);
+    last = std::max(last, record.time);
+    if (record.epoch != epoch) {
+      epoch = record.epoch;
+      stats.layoutChanges++;
+    }
+    if (record.kind == kTraceKindRepeat) {
+      stats.recordedRepeats++;
+      continue;
+    }
+    auto iter = index.find(record.hotkey);
+    if (iter == index.end()) {
+      stats.unknown++;
+      continue;
+    }
+    stats.events++;
+    HotKeyRepeatModel &model = models[iter->second];
+    bool invoked = record.kind == kTraceKindPressed ? model.pressed(record.time) : model.released(record.time);
+    if (invoked) {
+      stats.invocations++;
+      invoke(record.hotkey, record.time, false);
+    }
+    schedule(iter->second);
+  }
+  /* Keys still down at the end of the trace repeat until the last record time only */
+  fireUntil(last + 1);
+  stats.duration = last - start;
+  return stats;
+}
+
+} // namespace hk
+
+#endif /* HK_EVENT_REPLAY_H__ */
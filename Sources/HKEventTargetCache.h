@@ -0,0 +1,145 @@
+/*
+ *  HKEventTargetCache.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_EVENT_TARGET_CACHE_H__)
+#define HK_EVENT_TARGET_CACHE_H__ 1
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace hk {
+
+/*
+ Bundle identifier to pid resolution cache used by event target handles.
+
+ A bundle is resolved the first time a target is used, and the answer (including 'not running')
+ is kept until the cache is told the application was launched or terminated.
+ Each target also owns an event source created once, so posting to an already resolved target
+ does not perform any lookup nor allocation.
+
+ Platform specific operations are provided by Traits:
+ - Source: the event source type.
+ - static int32_t Resolve(const std::string &bundle): returns the pid or -1 if not running.
+ - static Source CreateSource(void);
+ - static void ReleaseSource(Source source);
+
+ acquire/release/invalidate are serialized by a lock. resolve() is lock free.
+ */
+template<class Traits>
+class EventTargetCache {
+public:
+  typedef typename Traits::Source Source;
+
+  class Target {
+    friend class EventTargetCache;
+  private:
+    std::string _bundle;
+    Source _source;
+    /* generation (32 high bits) | pid (32 low bits) */
+    std::atomic<uint64_t> _state;
+    uint32_t _refcount = 0;
+
+    Target(const std::string &bundle) : _bundle(bundle), _source(Traits::CreateSource()), _state(kUnresolved) {}
+    ~Target() { Traits::ReleaseSource(_source); }
+
+  public:
+    const std::string &bundle() const { return _bundle; }
+    Source source() const { return _source; }
+  };
+
+  EventTargetCache() = default;
+  EventTargetCache(const EventTargetCache &) = delete;
+  EventTargetCache &operator=(const EventTargetCache &) = delete;
+
+  ~EventTargetCache() {
+    for (auto &iter : _targets)
+      delete iter.second;
+  }
+
+  /* Returns the target for bundle, creating it if needed. Must be balanced by a call to release() */
+  Target *acquire(const std::string &bundle) {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto iter = _targets.find(bundle);
+    if (iter == _targets.end())
+      iter = _targets.emplace(bundle, new Target(bundle)).first;
+    iter->second->_refcount++;
+    return iter->second;
+  }
+
+  void release(Target *target) {
+    std::lock_guard<std::mutex> lock(_lock);
+    if (--target->_refcount == 0) {
+      _targets.erase(target->_bundle);
+      delete target;
+    }
+  }
+
+  /* Returns the target pid or -1 if the application is not running. */
+  int32_t resolve(Target *target) {
+    uint64_t state = target->_state.load(std::memory_order_acquire);
+    if (static_cast<uint32_t>(state) != kUnresolvedPid)
+      return __Pid(state);
+
+    _resolutions.fetch_add(1, std::memory_order_relaxed);
+    int32_t pid = Traits::Resolve(target->_bundle);
+    if (pid < 0)
+      pid = -1;
+    /* If the target was invalidated while resolving, the result is returned but not cached */
+    uint64_t resolved = (state & kGenerationMask) | static_cast<uint32_t>(pid);
+    target->_state.compare_exchange_strong(state, resolved, std::memory_order_acq_rel);
+    return pid;
+  }
+
+  /* Should be called when an application with this bundle identifier is launched or terminated. */
+  void invalidate(const std::string &bundle) {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto iter = _targets.find(bundle);
+    if (iter != _targets.end())
+      __Invalidate(iter->second);
+  }
+
+  void invalidateAll() {
+    std::lock_guard<std::mutex> lock(_lock);
+    for (auto &iter : _targets)
+      __Invalidate(iter.second);
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _targets.size();
+  }
+
+  /* Number of Traits::Resolve() calls. Debugging purpose */
+  uint64_t resolutions() const { return _resolutions.load(std::memory_order_relaxed); }
+
+private:
+  static constexpr uint32_t kUnresolvedPid = 0x80000000;
+  static constexpr uint64_t kUnresolved = kUnresolvedPid;
+  static constexpr uint64_t kGenerationMask = 0xffffffff00000000ULL;
+
+  static int32_t __Pid(uint64_t state) { return static_cast<int32_t>(state & 0xffffffff); }
+
+  static void __Invalidate(Target *target) {
+    uint64_t state = target->_state.load(std::memory_order_relaxed);
+    uint64_t invalid;
+    do {
+      invalid = ((state & kGenerationMask) + (1ULL << 32)) | kUnresolved;
+    } while (!target->_state.compare_exchange_weak(state, invalid, std::memory_order_acq_rel));
+  }
+
+  mutable std::mutex _lock;
+  std::unordered_map<std::string, Target *> _targets;
+  std::atomic<uint64_t> _resolutions{0};
+};
+
+} // namespace hk
+
+#endif /* HK_EVENT_TARGET_CACHE_H__ */
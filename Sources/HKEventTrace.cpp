@@ -0,0 +1,186 @@
+/*
+ *  HKEventTrace.cpp
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#include "HKEventTrace.h"
+
+#include <algorithm>
+
+namespace hk {
+
+// MARK: File Format
+struct __TraceHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recordSize;
+  uint32_t hotkeys;
+  uint32_t records;
+};
+static_assert(sizeof(__TraceHeader) == 16, "invalid trace header size");
+
+bool TraceWrite(const Trace &trace, FILE *f) {
+  __TraceHeader header = {
+    kTraceMagic, kTraceVersion, sizeof(TraceRecord),
+    static_cast<uint32_t>(trace.hotkeys.size()), static_cast<uint32_t>(trace.records.size())
+  };
+  if (fwrite(&header, sizeof(header), 1, f) != 1)
+    return false;
+  if (!trace.hotkeys.empty() && fwrite(trace.hotkeys.data(), sizeof(TraceHotKey), trace.hotkeys.size(), f) != trace.hotkeys.size())
+    return false;
+  if (!trace.records.empty() && fwrite(trace.records.data(), sizeof(TraceRecord), trace.records.size(), f) != trace.records.size())
+    return false;
+  return true;
+}
+
+bool TraceRead(Trace &trace, FILE *f) {
+  __TraceHeader header;
+  if (fread(&header, sizeof(header), 1, f) != 1)
+    return false;
+  if (header.magic != kTraceMagic || header.version != kTraceVersion || header.recordSize != sizeof(TraceRecord))
+    return false;
+
+  /* the counts are not trusted: they must match the remaining file size before anything is allocated */
+  long start = ftell(f);
+  if (start < 0 || fseek(f, 0, SEEK_END) != 0)
+    return false;
+  long end = ftell(f);
+  if (end < start || fseek(f, start, SEEK_SET) != 0)
+    return false;
+  uint64_t expected = uint64_t(header.hotkeys) * sizeof(TraceHotKey) + uint64_t(header.records) * sizeof(TraceRecord);
+  if (expected != static_cast<uint64_t>(end - start))
+    return false;
+
+  trace.hotkeys.resize(header.hotkeys);
+  trace.records.resize(header.records);
+  if (header.hotkeys && fread(trace.hotkeys.data(), sizeof(TraceHotKey), header.hotkeys, f) != header.hotkeys)
+    return false;
+  if (header.records && fread(trace.records.data(), sizeof(TraceRecord), header.records, f) != header.records)
+    return false;
+  return true;
+}
+
+// MARK: Recorder
+struct __TraceBuffer {
+  enum { kCapacity = 256 };
+
+  /* only contended when stop() drains the buffer */
+  std::mutex lock;
+  TraceRecord records[kCapacity];
+  size_t count = 0;
+  uint32_t session = 0;
+
+  __TraceBuffer() { TraceRecorder::shared().__register(this); }
+  ~__TraceBuffer() { TraceRecorder::shared().__unregister(this); }
+
+  /* Moves the pending records out of the buffer. Returns the record count */
+  size_t take(TraceRecord (&out)[kCapacity], uint32_t &outSession) {
+    std::lock_guard<std::mutex> guard(lock);
+    size_t taken = count;
+    std::copy(records, records + count, out);
+    outSession = session;
+    count = 0;
+    return taken;
+  }
+
+  void flush() {
+    TraceRecord pending[kCapacity];
+    uint32_t pendingSession;
+    if (size_t taken = take(pending, pendingSession))
+      TraceRecorder::shared().__collect(pending, taken, pendingSession);
+  }
+};
+
+static thread_local __TraceBuffer sTraceBuffer;
+
+TraceRecorder &TraceRecorder::shared() {
+  static auto *sRecorder = new TraceRecorder();
+  return *sRecorder;
+}
+
+void TraceRecorder::start() {
+  std::lock_guard<std::mutex> lock(_lock);
+  _trace = Trace();
+  _session.fetch_add(1, std::memory_order_relaxed);
+  _recording.store(true, std::memory_order_release);
+}
+
+Trace TraceRecorder::stop() {
+  std::lock_guard<std::mutex> lock(_lock);
+  _recording.store(false, std::memory_order_release);
+  uint32_t session = _session.load(std::memory_order_relaxed);
+  for (__TraceBuffer *buffer : _buffers) {
+    std::lock_guard<std::mutex> guard(buffer->lock);
+    if (buffer->session == session)
+      _trace.records.insert(_trace.records.end(), buffer->records, buffer->records + buffer->count);
+    buffer->count = 0;
+  }
+  Trace trace = std::move(_trace);
+  _trace = Trace();
+  /* Buffers are flushed independently, so records may be out of order */
+  std::stable_sort(trace.records.begin(), trace.records.end(), [](const TraceRecord &lhs, const TraceRecord &rhs) {
+    return lhs.time < rhs.time;
+  });
+  return trace;
+}
+
+void TraceRecorder::describe(const TraceHotKey &hotkey) {
+  std::lock_guard<std::mutex> lock(_lock);
+  if (!isRecording())
+    return;
+  for (TraceHotKey &desc : _trace.hotkeys) {
+    if (desc.hotkey == hotkey.hotkey) {
+      desc = hotkey;
+      return;
+    }
+  }
+  _trace.hotkeys.push_back(hotkey);
+}
+
+void TraceRecorder::flush() {
+  sTraceBuffer.flush();
+}
+
+void TraceRecorder::__append(const TraceRecord &record) {
+  __TraceBuffer &buffer = sTraceBuffer;
+  bool full;
+  {
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    /* a record may be appended after stop() (the recording flag is checked without lock) */
+    uint32_t session = _session.load(std::memory_order_relaxed);
+    if (buffer.session != session) {
+      buffer.session = session;
+      buffer.count = 0;
+    }
+    buffer.records[buffer.count++] = record;
+    full = buffer.count == __TraceBuffer::kCapacity;
+  }
+  if (full)
+    buffer.flush();
+}
+
+void TraceRecorder::__collect(const TraceRecord *records, size_t count, uint32_t session) {
+  std::lock_guard<std::mutex> lock(_lock);
+  /* drop records from a previous session */
+  if (isRecording() && session == _session.load(std::memory_order_relaxed))
+    _trace.records.insert(_trace.records.end(), records, records + count);
+}
+
+void TraceRecorder::__register(__TraceBuffer *buffer) {
+  std::lock_guard<std::mutex> lock(_lock);
+  _buffers.push_back(buffer);
+}
+
+void TraceRecorder::__unregister(__TraceBuffer *buffer) {
+  std::lock_guard<std::mutex> lock(_lock);
+  _buffers.erase(std::find(_buffers.begin(), _buffers.end(), buffer));
+  /* the thread is exiting: nothing can be appended anymore */
+  if (buffer->count && isRecording() && buffer->session == _session.load(std::memory_order_relaxed))
+    _trace.records.insert(_trace.records.end(), buffer->records, buffer->records + buffer->count);
+  buffer->count = 0;
+}
+
+} // namespace hk
@@ -0,0 +1,126 @@
+/*
+ *  HKEventTrace.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_EVENT_TRACE_H__)
+#define HK_EVENT_TRACE_H__ 1
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/*
+ Hot key event traces.
+
+ A trace records the events that reach the hot key dispatcher, so a sequence reported
+ by a user ('hotkey fired twice', 'repeat stutters', …) can be replayed deterministically
+ (see HKEventReplay.h).
+
+ File format (host byte order):
+ --------------------------------------------------------------------
+ | header      | magic 'HKTR' | version | record size | hotkeys | records |
+ | hotkeys     | TraceHotKey[hotkeys]                                 |
+ | records     | TraceRecord[records]                                 |
+ --------------------------------------------------------------------
+ */
+namespace hk {
+
+enum TraceKind : uint8_t {
+  kTraceKindPressed = 1,
+  kTraceKindReleased = 2,
+  /* repeat timer fired (informative, replay recomputes repeats) */
+  kTraceKindRepeat = 3,
+};
+
+struct TraceRecord {
+  uint64_t time; // event time in nanoseconds
+  uint32_t hotkey; // hotkey uid
+  uint8_t kind; // TraceKind
+  uint8_t flags; // reserved
+  uint16_t epoch; // layout epoch (low bits)
+};
+static_assert(sizeof(TraceRecord) == 16, "trace records must be 16 bytes");
+
+enum : uint32_t {
+  kTraceHotKeyInvokeOnKeyUp = 1 << 0,
+};
+
+/* Describe the repeat configuration of a hotkey */
+struct TraceHotKey {
+  uint32_t hotkey; // hotkey uid
+  uint32_t flags;
+  uint32_t initialRepeatInterval; // µs
+  uint32_t repeatInterval; // µs, 0 means no repeat
+};
+static_assert(sizeof(TraceHotKey) == 16, "trace hotkeys must be 16 bytes");
+
+struct Trace {
+  std::vector<TraceHotKey> hotkeys;
+  std::vector<TraceRecord> records;
+};
+
+enum : uint32_t {
+  kTraceMagic = 0x484b5452, // 'HKTR'
+  kTraceVersion = 1,
+};
+
+bool TraceWrite(const Trace &trace, FILE *f);
+bool TraceRead(Trace &trace, FILE *f);
+
+/*
+ Trace recorder.
+ When disabled, record() is a single relaxed load. When enabled, records are appended to a
+ per thread buffer, that is moved into the trace when full, when the thread exits, or when
+ flush() is called from this thread. Buffers are registered with the recorder, so stop()
+ collects the pending records of all threads.
+ */
+struct __TraceBuffer;
+
+class TraceRecorder {
+public:
+  static TraceRecorder &shared();
+
+  bool isRecording() const { return _recording.load(std::memory_order_relaxed); }
+
+  void start();
+  /* Stops recording, collects the pending records of all threads and returns the trace. */
+  Trace stop();
+
+  inline void record(uint64_t time, uint32_t hotkey, TraceKind kind, uint16_t epoch) {
+    if (isRecording())
+      __append({ time, hotkey, kind, 0, epoch });
+  }
+
+  void describe(const TraceHotKey &hotkey);
+
+  /* Moves the calling thread pending records into the trace */
+  void flush();
+
+private:
+  friend struct __TraceBuffer;
+
+  void __append(const TraceRecord &record);
+  void __collect(const TraceRecord *records, size_t count, uint32_t session);
+
+  void __register(__TraceBuffer *buffer);
+  void __unregister(__TraceBuffer *buffer);
+
+  std::atomic<bool> _recording{false};
+  /* incremented by start(). Records pending from a previous session are discarded */
+  std::atomic<uint32_t> _session{0};
+  /* lock order: _lock, then buffer lock */
+  std::mutex _lock;
+  std::vector<__TraceBuffer *> _buffers;
+  Trace _trace;
+};
+
+} // namespace hk
+
+#endif /* HK_EVENT_TRACE_H__ */
@@ -130,6 +130,15 @@ HK_OBJC_EXPORT
  */
 - (BOOL)setRegistred:(BOOL)flag;
 
+/*!
+  @method
+ @abstract   Thread safe version of -setRegistred:.
+ @discussion Can be called from any thread, and never blocks: the request is queued and applied on the main thread,
+ in a single pass with the other pending requests. Requests are applied in the order they are made.
+ @param      handler Called on the main thread with the result of -setRegistred:. May be nil.
+ */
+- (void)setRegistred:(BOOL)flag completionHandler:(void (^)(BOOL success))handler;
+
 /*!
  @property
  @abstract  Time interval between two autorepeat key down events.
@@ -208,3 +217,22 @@ BOOL HKHotKeyCheckKeyCodeAndModifier(HKKeycode code, HKModifier modifier);
 /* Debugging purpose */
 HK_EXPORT BOOL HKTraceHotKeyEvents;
 
+/*!
+ @function
+ @abstract   Starts recording hotkey events in a compact binary trace.
+ @discussion The trace contains the pressed, released and repeat events of registred hotkeys, with their
+ timestamp and the keyboard layout epoch, and the repeat configuration of these hotkeys.
+ It can be replayed deterministically using the HKTraceReplay tool.
+ */
+HK_EXPORT
+void HKHotKeyTraceStart(void);
+
+/*!
+ @function
+ @abstract   Stops recording and writes the trace to <i>path</i>.
+ @param      path The trace file path. If nil, the trace is discarded.
+ @result     Returns NO if the trace cannot be written.
+ */
+HK_EXPORT
+BOOL HKHotKeyTraceStop(NSString *path);
+
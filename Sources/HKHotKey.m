@@ -10,6 +10,7 @@
 
 #import "HKKeyMap.h"
 #import "HKHotKeyManager.h"
+#import "HKKeymapInternal.h"
 
 #include <IOKit/hidsystem/IOHIDLib.h>
 #include <IOKit/hidsystem/IOHIDParameter.h>
@@ -117,7 +118,7 @@ CFTimeInterval __HKEventTime(void) {
 }
 
 - (NSString*)shortcut {
-  return [HKKeyMap stringRepresentationForCharacter:self.character modifiers:_nativeModifier];
+  return HKKeyMapGetShortcutString(self.character, _nativeModifier);
 }
 
 #pragma mark -
@@ -167,6 +168,12 @@ void _checkNotRegistred(HKHotKey *self) {
   [self didChangeValueForKey:SPXProperty(character)];
 }
 
+void HKHotKeyUpdateRegistredKeycode(HKHotKey *hotkey, HKKeycode keycode) {
+  [hotkey willChangeValueForKey:SPXProperty(keycode)];
+  hotkey->_keycode = keycode;
+  [hotkey didChangeValueForKey:SPXProperty(keycode)];
+}
+
 - (BOOL)isRegistred { return _hkFlags.registred; }
 
 - (BOOL)setRegistred:(BOOL)flag {
@@ -191,6 +198,10 @@ void _checkNotRegistred(HKHotKey *self) {
   return result;
 }
 
+- (void)setRegistred:(BOOL)flag completionHandler:(void (^)(BOOL success))handler {
+  HKHotKeyEnqueueRegistration(self, flag, handler);
+}
+
 - (BOOL)invokeOnKeyUp { return _hkFlags.onrelease; }
 - (void)setInvokeOnKeyUp:(BOOL)flag { SPXFlagSet(_hkFlags.onrelease, flag); }
 
@@ -295,6 +306,7 @@ void _checkNotRegistred(HKHotKey *self) {
   if (HKTraceHotKeyEvents) {
     NSLog(@"Repeat event: %@", self);
   }
+  HKHotKeyTraceRepeat(self, _eventTime);
   if (!_hkFlags.onrelease)
     [self invoke:YES];
 }
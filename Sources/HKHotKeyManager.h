@@ -19,3 +19,28 @@ BOOL HKHotKeyUnregister(HKHotKey *hotkey);
 HK_PRIVATE
 BOOL HKHotKeyUnregisterAll(void);
 
+/* Thread safe: queues the command, executed on the main thread with the other pending commands. handler is called on the main thread. */
+HK_PRIVATE
+void HKHotKeyEnqueueRegistration(HKHotKey *hotkey, BOOL flag, void (^handler)(BOOL success));
+
+
+/*!
+ @function
+ @abstract   Same as HKHotKeyCheckKeyCodeAndModifier(), but remembers the result.
+ @discussion The cache is cleared each time a hotkey is registred or unregistred, and by HKHotKeyInvalidateCheckCache()
+ (called when a trap window starts trapping or becomes key, as other applications may register hotkeys).
+ Main thread only.
+ */
+HK_PRIVATE
+BOOL HKHotKeyCheckKeyCodeAndModifierCached(HKKeycode code, HKModifier modifier);
+
+HK_PRIVATE
+void HKHotKeyInvalidateCheckCache(void);
+
+/* Records a repeat in the current event trace (see HKHotKeyTraceStart()) */
+HK_PRIVATE
+void HKHotKeyTraceRepeat(HKHotKey *hotkey, NSTimeInterval eventTime);
+
+/* Changes the keycode of a registred hotkey, without checking it is not registred (used to rebind hotkeys on layout change) */
+HK_PRIVATE
+void HKHotKeyUpdateRegistredKeycode(HKHotKey *hotkey, HKKeycode keycode);
@@ -10,8 +10,15 @@
 
 #import "HKHotKey.h"
 #import "HKHotKeyManager.h"
+#import "HKKeymapInternal.h"
 
-#import <unordered_map>
+#import <algorithm>
+#import <vector>
+
+#include "HKCommandQueue.h"
+#include "HKEventTrace.h"
+#include "HKHotKeyRebind.h"
+#include "HKHotKeyRegistry.h"
 
 #include <Carbon/Carbon.h>
 
@@ -37,24 +44,12 @@ OSStatus _HKRegisterHotKey(HKKeycode keycode, HKModifier modifier, EventHotKeyID
 
 HK_INLINE
 OSStatus _HKUnregisterHotKey(EventHotKeyRef ref) {
-  return UnregisterEventHotKey(ref);
+  /* ref is NULL if a hotkey could not be registred again after a layout change */
+  return ref ? UnregisterEventHotKey(ref) : noErr;
 }
 
-static uint32_t sHotKeyUID = 0;
 static EventHandlerRef sHandler;
 
-static
-std::unordered_map<uint32_t, __unsafe_unretained HKHotKey *>&HotKeyMap() {
-  static auto *sHotKeys = new std::unordered_map<uint32_t, __unsafe_unretained HKHotKey *>;
-  return *sHotKeys;
-}
-
-static
-std::unordered_map<__unsafe_unretained HKHotKey *, EventHotKeyRef, spx::hash> &HotKeyReferencesMap() {
-  static auto *sHotKeyReferences = new std::unordered_map<__unsafe_unretained HKHotKey *, EventHotKeyRef, spx::hash>;
-  return *sHotKeyReferences;
-}
-
 /* Debugging purpose */
 BOOL HKTraceHotKeyEvents = NO;
 
@@ -86,85 +81,232 @@ void _HKManagerUninstallEventHandler(void) {
   sHandler = NULL;
 }
 
+// MARK: Registry
+static void _HKHotKeyLayoutDidChange(HKKeyMapContext *previous, HKKeyMapContext *current);
+
+struct HKCarbonRegistryTraits {
+  typedef __unsafe_unretained HKHotKey *HotKey;
+  typedef EventHotKeyRef Ref;
+  typedef spx::hash Hash;
+
+  static bool Register(HKHotKey *hotkey, uint32_t uid, EventHotKeyRef *ref) {
+    EventHotKeyID hotKeyId = { kHKHotKeyEventSignature, static_cast<UInt32>(uid) };
+    return noErr == _HKRegisterHotKey(hotkey.keycode, hotkey.nativeModifier, hotKeyId, ref);
+  }
+
+  static bool Unregister(HKHotKey *hotkey, EventHotKeyRef ref) {
+    OSStatus err = _HKUnregisterHotKey(ref);
+    if (noErr != err)
+      spx_log_error("error while unregistering hotkey %@ : %s", hotkey, _OSStatusToStr(err));
+    return noErr == err;
+  }
+
+  static bool InstallHandler() {
+    if (!_HKManagerInstallEventHandler())
+      return false;
+    HKKeyMapSetLayoutObserver(_HKHotKeyLayoutDidChange);
+    return true;
+  }
+  static void UninstallHandler() {
+    /* no hotkey to rebind: layout changes no longer have to load the new layout eagerly */
+    HKKeyMapSetLayoutObserver(NULL);
+    _HKManagerUninstallEventHandler();
+  }
+};
+
+typedef hk::HotKeyRegistry<HKCarbonRegistryTraits> HKCarbonRegistry;
+
+static
+HKCarbonRegistry &_HKHotKeyRegistry() {
+  static auto *sRegistry = new HKCarbonRegistry();
+  return *sRegistry;
+}
+
+// MARK: Event Trace
 HK_INLINE
-bool _HKHotKeyIsRegistred(HKHotKey *hotkey) {
-  const auto &map = HotKeyReferencesMap();
-  return map.find(hotkey) != map.end();
+uint64_t _HKTraceTime(NSTimeInterval eventTime) {
+  return static_cast<uint64_t>(eventTime * 1e9);
 }
 
-BOOL HKHotKeyRegister(HKHotKey *hotkey) {
-  // Si la cle est valide est non enregistré
-  if ([hotkey isValid] && !_HKHotKeyIsRegistred(hotkey)) {
-    uint32_t uid = ++sHotKeyUID;
-    HKKeycode keycode = hotkey.keycode;
-    HKModifier mask = hotkey.nativeModifier;
+HK_INLINE
+void _HKTraceRecord(uint32_t uid, hk::TraceKind kind, NSTimeInterval eventTime) {
+  hk::TraceRecorder &recorder = hk::TraceRecorder::shared();
+  if (recorder.isRecording())
+    recorder.record(_HKTraceTime(eventTime), uid, kind, static_cast<uint16_t>(HKKeyMapGetLayoutEpoch()));
+}
+
+static
+void _HKTraceDescribeHotKey(HKHotKey *hotkey, uint32_t uid) {
+  hk::TraceRecorder &recorder = hk::TraceRecorder::shared();
+  if (!recorder.isRecording())
+    return;
+
+  hk::TraceHotKey desc = { uid, 0, 0, 0 };
+  if (hotkey.invokeOnKeyUp)
+    desc.flags |= hk::kTraceHotKeyInvokeOnKeyUp;
+  if (hotkey.repeatInterval > 0) {
+    desc.repeatInterval = static_cast<uint32_t>(hotkey.repeatInterval * 1e6);
+    desc.initialRepeatInterval = static_cast<uint32_t>(std::max(0., hotkey.initialRepeatInterval) * 1e6);
+  }
+  recorder.describe(desc);
+}
+
+void HKHotKeyTraceStart(void) {
+  hk::TraceRecorder::shared().start();
+  _HKHotKeyRegistry().withRecords([](const HKCarbonRegistry::Records &records) {
+    for (const auto &iter : records)
+      _HKTraceDescribeHotKey(iter.first, iter.second.uid);
+  });
+}
+
+BOOL HKHotKeyTraceStop(NSString *path) {
+  hk::Trace trace = hk::TraceRecorder::shared().stop();
+  if (!path)
+    return YES;
+
+  FILE *f = fopen(path.fileSystemRepresentation, "wb");
+  if (!f) {
+    spx_log_error("failed to create trace file %@: %s", path, strerror(errno));
+    return NO;
+  }
+  bool ok = hk::TraceWrite(trace, f);
+  if (0 != fclose(f))
+    ok = false;
+  if (!ok)
+    spx_log_error("failed to write trace file %@", path);
+  return ok;
+}
+
+void HKHotKeyTraceRepeat(HKHotKey *hotkey, NSTimeInterval eventTime) {
+  if (!hk::TraceRecorder::shared().isRecording())
+    return;
+  if (uint32_t uid = _HKHotKeyRegistry().uid(hotkey))
+    _HKTraceRecord(uid, hk::kTraceKindRepeat, eventTime);
+}
+
+// MARK: Layout Change
+/* Registers again the hotkeys whose character moved to an other key, in a single batch */
+static
+void _HKHotKeyLayoutDidChange(HKKeyMapContext *previous, HKKeyMapContext *current) {
+  std::vector<std::pair<__unsafe_unretained HKHotKey *, HKKeycode>> rebound;
+  _HKHotKeyRegistry().withRecords([&](HKCarbonRegistry::Records &records) {
+    std::vector<HKCarbonRegistry::Records::iterator> entries;
+    std::vector<hk::KeycodeBinding> bindings;
+    entries.reserve(records.size());
+    bindings.reserve(records.size());
+    for (auto iter = records.begin(); iter != records.end(); ++iter) {
+      entries.push_back(iter);
+      bindings.push_back({ iter->first.character, iter->first.keycode, iter->first.nativeModifier });
+    }
+
+    std::vector<hk::KeycodeChange> changes = hk::DiffBindings(previous, current, bindings);
+    if (changes.empty())
+      return;
 
     if (HKTraceHotKeyEvents)
-      NSLog(@"Registering HotKey %@", hotkey);
+      spx_log("Layout changed: rebinding %zu of %zu hotkeys", changes.size(), bindings.size());
 
-    EventHotKeyRef ref = NULL;
-    EventHotKeyID hotKeyId = { kHKHotKeyEventSignature, static_cast<UInt32>(uid) };
-    if (noErr == _HKRegisterHotKey(keycode, mask, hotKeyId, &ref)) {
-      if (HotKeyReferencesMap().empty())
-        if (!_HKManagerInstallEventHandler()) {
-          _HKUnregisterHotKey(ref);
-          return NO;
-        }
-
-      HotKeyReferencesMap()[hotkey] = ref;
-      HotKeyMap()[uid] = hotkey;
-      return YES;
+    /* unregister all first, as the new keycode of a hotkey may be the previous keycode of an other one */
+    for (const hk::KeycodeChange &change : changes) {
+      HKCarbonRegistry::Record &record = entries[change.index]->second;
+      _HKUnregisterHotKey(record.ref);
+      record.ref = NULL;
     }
-  }
-  return NO;
+    for (const hk::KeycodeChange &change : changes) {
+      HKHotKey *hotkey = entries[change.index]->first;
+      HKCarbonRegistry::Record &record = entries[change.index]->second;
+      EventHotKeyID hotKeyId = { kHKHotKeyEventSignature, static_cast<UInt32>(record.uid) };
+      HKKeycode keycode = change.keycode;
+      OSStatus err = _HKRegisterHotKey(keycode, hotkey.nativeModifier, hotKeyId, &record.ref);
+      if (noErr != err) {
+        /* the new keystroke is not available: keep the previous one */
+        keycode = hotkey.keycode;
+        err = _HKRegisterHotKey(keycode, hotkey.nativeModifier, hotKeyId, &record.ref);
+      }
+      if (noErr != err) {
+        spx_log_error("error while registering hotkey %@ after layout change: %s", hotkey, _OSStatusToStr(err));
+        record.ref = NULL;
+      } else if (keycode != hotkey.keycode) {
+        rebound.emplace_back(hotkey, keycode);
+      }
+    }
+  });
+  /* outside of the registry lock, as it triggers KVO notifications */
+  for (const auto &entry : rebound)
+    HKHotKeyUpdateRegistredKeycode(entry.first, entry.second);
+  HKHotKeyInvalidateCheckCache();
 }
 
-BOOL HKHotKeyUnregister(HKHotKey *hotkey) {
-  if (!_HKHotKeyIsRegistred(hotkey))
+// MARK: -
+BOOL HKHotKeyRegister(HKHotKey *hotkey) {
+  // Si la cle est valide est non enregistré
+  if (![hotkey isValid])
     return NO;
 
-  const auto &ref = HotKeyReferencesMap().find(hotkey);
-  if (ref == HotKeyReferencesMap().end()) {
-    NSCAssert(false, @"Unable to find Carbon HotKey Handler");
+  if (HKTraceHotKeyEvents)
+    NSLog(@"Registering HotKey %@", hotkey);
+
+  uint32_t uid = _HKHotKeyRegistry().add(hotkey);
+  if (!uid)
     return NO;
-  }
 
-  OSStatus err = _HKUnregisterHotKey(ref->second);
-  if (noErr != err) {
-    spx_log_error("error while unregistering hotkey %@ : %s", hotkey, _OSStatusToStr(err));
+  HKHotKeyInvalidateCheckCache();
+  _HKTraceDescribeHotKey(hotkey, uid);
+  return YES;
+}
+
+BOOL HKHotKeyUnregister(HKHotKey *hotkey) {
+  if (!_HKHotKeyRegistry().remove(hotkey))
     return NO;
-  }
 
   if (HKTraceHotKeyEvents)
     spx_log("Unregister HotKey: %@", hotkey);
 
-  HotKeyReferencesMap().erase(ref);
-
-  /* Remove from keys record */
-  for (const auto& iter : HotKeyMap()) {
-    if (iter.second == hotkey) {
-      HotKeyMap().erase(iter.first);
-      break;
-    }
-  }
-  if (HotKeyReferencesMap().empty())
-    _HKManagerUninstallEventHandler();
+  HKHotKeyInvalidateCheckCache();
   return YES;
 }
 
 BOOL HKHotKeyUnregisterAll(void) {
-  if (!HotKeyReferencesMap().empty()) {
-    for (const auto& iter : HotKeyReferencesMap()) {
-      _HKUnregisterHotKey(iter.second);
-    }
-    HotKeyReferencesMap().clear();
-    HotKeyMap().clear();
-
-    _HKManagerUninstallEventHandler();
-  }
+  if (_HKHotKeyRegistry().clear())
+    HKHotKeyInvalidateCheckCache();
   return YES;
 }
 
+// MARK: Registration Queue
+struct HKRegistrationCommand {
+  HKHotKey *hotkey;
+  BOOL registred;
+};
+
+typedef hk::CommandQueue<HKRegistrationCommand, BOOL> HKRegistrationQueue;
+
+static
+void _HKRegistrationQueueDrain(void *context);
+
+static
+HKRegistrationQueue &_HKRegistrationQueue() {
+  /* hotkeys must be registred on the thread owning the application event target: the main thread */
+  static auto *sQueue = new HKRegistrationQueue([] {
+    dispatch_async_f(dispatch_get_main_queue(), NULL, _HKRegistrationQueueDrain);
+  });
+  return *sQueue;
+}
+
+void _HKRegistrationQueueDrain(void *context) {
+  size_t count = _HKRegistrationQueue().drain([](HKRegistrationCommand &command) -> BOOL {
+    return [command.hotkey setRegistred:command.registred];
+  });
+  if (HKTraceHotKeyEvents)
+    spx_log("Registration queue: %zu commands executed", count);
+}
+
+void HKHotKeyEnqueueRegistration(HKHotKey *hotkey, BOOL flag, void (^handler)(BOOL success)) {
+  HKRegistrationQueue::Completion completion;
+  if (handler)
+    completion = [handler](const BOOL &success) { handler(success); };
+  _HKRegistrationQueue().submit({ hotkey, flag }, std::move(completion));
+}
+
 //MARK: -
 BOOL HKHotKeyCheckKeyCodeAndModifier(HKKeycode code, HKModifier modifier) {
   BOOL isValid = NO;
@@ -179,6 +321,41 @@ BOOL HKHotKeyCheckKeyCodeAndModifier(HKKeycode code, HKModifier modifier) {
   return isValid;
 }
 
+// MARK: Check Cache
+/* Direct mapped cache of HKHotKeyCheckKeyCodeAndModifier() results.
+ Fixed size, so checking a keystroke never allocates. */
+enum {
+  kHKCheckCacheSize = 256,
+};
+
+enum : uint8_t {
+  kHKCheckCacheEmpty = 0,
+  kHKCheckCacheInvalid,
+  kHKCheckCacheValid,
+};
+
+struct HKCheckCacheEntry {
+  uint32_t key;
+  uint8_t state;
+};
+
+static HKCheckCacheEntry sHKCheckCache[kHKCheckCacheSize];
+
+BOOL HKHotKeyCheckKeyCodeAndModifierCached(HKKeycode code, HKModifier modifier) {
+  /* modifiers use only the 16 high bits */
+  uint32_t key = (modifier & 0xffff0000) | code;
+  HKCheckCacheEntry &entry = sHKCheckCache[((key >> 16) * 31 + key) & (kHKCheckCacheSize - 1)];
+  if (entry.state == kHKCheckCacheEmpty || entry.key != key) {
+    entry.key = key;
+    entry.state = HKHotKeyCheckKeyCodeAndModifier(code, modifier) ? kHKCheckCacheValid : kHKCheckCacheInvalid;
+  }
+  return entry.state == kHKCheckCacheValid;
+}
+
+void HKHotKeyInvalidateCheckCache(void) {
+  memset(sHKCheckCache, 0, sizeof(sHKCheckCache));
+}
+
 //MARK: Carbon Event Handler
 OSStatus _HandleHotKeyEvent(EventHandlerCallRef nextHandler, EventRef theEvent, void *userData) {
   NSCAssert(GetEventClass(theEvent) == kEventClassKeyboard, @"Unknown event class");
@@ -202,14 +379,15 @@ OSStatus _HandleHotKeyEvent(EventHandlerCallRef nextHandler, EventRef theEvent,
             NSFileTypeForHFSTypeCode(hotKeyID.signature),
             long(hotKeyID.id));
     }
-    const auto &entry = HotKeyMap().find(hotKeyID.id);
-    if (entry != HotKeyMap().end()) {
-      HKHotKey *hotKey = entry->second;
+    HKHotKey *hotKey = _HKHotKeyRegistry().find(hotKeyID.id);
+    if (hotKey) {
       switch(GetEventKind(theEvent)) {
         case kEventHotKeyPressed:
+          _HKTraceRecord(hotKeyID.id, hk::kTraceKindPressed, GetEventTime(theEvent));
           [hotKey keyPressed:GetEventTime(theEvent)];
           break;
         case kEventHotKeyReleased:
+          _HKTraceRecord(hotKeyID.id, hk::kTraceKindReleased, GetEventTime(theEvent));
           [hotKey keyReleased:GetEventTime(theEvent)];
           break;
         default:
@@ -0,0 +1,55 @@
+/*
+ *  HKHotKeyRebind.cpp
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#include "HKHotKeyRebind.h"
+
+#include <unordered_map>
+
+HKKeycode hk::ResolveKeycode(HKKeyMapContext *ctxt, UniChar character) {
+  if (!ctxt || character == kKeyMapNilCharacter)
+    return kRebindInvalidKeycode;
+
+  HKKeycode keys[4];
+  HKModifier modifiers[4];
+  size_t count = HKKeycodesForCharacterFunction(ctxt, character, keys, modifiers, 4);
+  if (!count || count > 2 || keys[0] == kRebindInvalidKeycode)
+    return kRebindInvalidKeycode;
+  /* dead key: the second keycode is space key */
+  if (count == 2 && keys[1] != kRebindSpaceKeycode)
+    return kRebindInvalidKeycode;
+  return keys[0];
+}
+
+std::vector<hk::KeycodeChange> hk::DiffBindings(HKKeyMapContext *previous, HKKeyMapContext *current, const std::vector<KeycodeBinding> &bindings) {
+  struct Resolution {
+    HKKeycode previous;
+    HKKeycode current;
+  };
+  /* many hotkeys share the same character */
+  std::unordered_map<UniChar, Resolution> resolutions;
+  std::vector<KeycodeChange> changes;
+  for (size_t idx = 0; idx < bindings.size(); idx++) {
+    const KeycodeBinding &binding = bindings[idx];
+    if (IsKeycodeBinding(binding))
+      continue;
+
+    auto iter = resolutions.find(binding.character);
+    if (iter == resolutions.end()) {
+      Resolution resolution = { ResolveKeycode(previous, binding.character), kRebindInvalidKeycode };
+      /* no need to resolve the current keycode if the previous one is invalid */
+      if (resolution.previous != kRebindInvalidKeycode)
+        resolution.current = ResolveKeycode(current, binding.character);
+      iter = resolutions.emplace(binding.character, resolution).first;
+    }
+    const Resolution &resolution = iter->second;
+    if (resolution.previous != binding.keycode || resolution.current == kRebindInvalidKeycode || resolution.current == resolution.previous)
+      continue;
+    changes.push_back({ idx, resolution.current });
+  }
+  return changes;
+}
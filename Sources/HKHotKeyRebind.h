@@ -0,0 +1,63 @@
+/*
+ *  HKHotKeyRebind.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_HOTKEY_REBIND_H__)
+#define HK_HOTKEY_REBIND_H__ 1
+
+#include "HKKeyMapContext.h"
+
+#include <vector>
+
+/*
+ Hotkeys rebinding on layout change.
+
+ A character based hotkey resolves its keycode against the current layout. When the layout changes,
+ the previous and current contexts are compared for the characters of the registered hotkeys, and
+ only the hotkeys whose keycode changed have to be registered again.
+ */
+namespace hk {
+
+constexpr HKKeycode kRebindInvalidKeycode = 0xffff;
+constexpr HKKeycode kRebindSpaceKeycode = 0x31;
+
+/* A registered hotkey */
+struct KeycodeBinding {
+  UniChar character;
+  HKKeycode keycode;
+  HKModifier modifier;
+};
+
+struct KeycodeChange {
+  size_t index; // binding index
+  HKKeycode keycode; // new keycode
+};
+
+/*
+ Same resolution as -[HKKeyMap keycodeForCharacter:modifiers:]: the first keycode of the keystrokes,
+ if the character needs a single keystroke, or a dead key followed by space.
+ */
+HKKeycode ResolveKeycode(HKKeyMapContext *ctxt, UniChar character);
+
+/* Keystrokes for which the keycode is used as is (see HKHotKeyUnpackKeystoke()) */
+HK_INLINE
+bool IsKeycodeBinding(const KeycodeBinding &binding) {
+  return (binding.modifier & (kCGEventFlagMaskNumericPad | kCGEventFlagMaskSecondaryFn)) ||
+    (binding.character >= '0' && binding.character <= '9');
+}
+
+/*
+ Returns the bindings that must be registered again, with their new keycode.
+ A binding changes if its keycode was resolved from its character in the previous context,
+ and resolves to an other valid keycode in the current one. Bindings whose character is not
+ available in the current layout are left unchanged.
+ */
+std::vector<KeycodeChange> DiffBindings(HKKeyMapContext *previous, HKKeyMapContext *current, const std::vector<KeycodeBinding> &bindings);
+
+} // namespace hk
+
+#endif /* HK_HOTKEY_REBIND_H__ */
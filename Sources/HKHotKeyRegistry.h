@@ -0,0 +1,157 @@
+/*
+ *  HKHotKeyRegistry.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_HOTKEY_REGISTRY_H__)
+#define HK_HOTKEY_REGISTRY_H__ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace hk {
+
+/*
+ Registered hotkeys.
+
+ Maps hotkeys to their platform registration (ref) and to the uid sent back by the platform
+ when the hotkey is pressed. The registry is thread safe: the maps and the uid counter are
+ protected by a single lock, and platform calls are done while holding it, so the registry
+ and the platform always agree on the set of registered hotkeys.
+ Traits callbacks must not call back into the registry.
+
+ Traits:
+ typedef <hotkey type> HotKey;  // hashable pointer-like type, HotKey() is the null hotkey
+ typedef <ref type> Ref;
+ typedef <hash functor> Hash;
+ static bool Register(HotKey hotkey, uint32_t uid, Ref *ref);
+ static bool Unregister(HotKey hotkey, Ref ref);
+ static bool InstallHandler();  // called before registering the first hotkey
+ static void UninstallHandler(); // called after unregistering the last one
+ */
+template<class Traits>
+class HotKeyRegistry {
+public:
+  typedef typename Traits::HotKey HotKey;
+  typedef typename Traits::Ref Ref;
+
+  struct Record {
+    Ref ref;
+    uint32_t uid;
+  };
+
+  typedef std::unordered_map<HotKey, Record, typename Traits::Hash> Records;
+
+  HotKeyRegistry() = default;
+  HotKeyRegistry(const HotKeyRegistry &) = delete;
+  HotKeyRegistry &operator=(const HotKeyRegistry &) = delete;
+
+  /* Returns the uid of the registered hotkey, or 0 if it is already registered or the platform refuses it */
+  uint32_t add(HotKey hotkey) {
+    std::lock_guard<std::mutex> lock(_lock);
+    if (_records.find(hotkey) != _records.end())
+      return 0;
+
+    uint32_t uid = __NextUID();
+    Ref ref;
+    if (!Traits::Register(hotkey, uid, &ref))
+      return 0;
+    if (_records.empty() && !Traits::InstallHandler()) {
+      Traits::Unregister(hotkey, ref);
+      return 0;
+    }
+    _records.emplace(hotkey, Record { ref, uid });
+    _hotkeys.emplace(uid, hotkey);
+    return uid;
+  }
+
+  /* Returns false if the hotkey is not registered, or the platform fails to unregister it (it stays registered) */
+  bool remove(HotKey hotkey) {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto iter = _records.find(hotkey);
+    if (iter == _records.end() || !Traits::Unregister(hotkey, iter->second.ref))
+      return false;
+
+    _hotkeys.erase(iter->second.uid);
+    _records.erase(iter);
+    if (_records.empty())
+      Traits::UninstallHandler();
+    return true;
+  }
+
+  /* Returns the number of hotkeys unregistered */
+  size_t clear() {
+    std::lock_guard<std::mutex> lock(_lock);
+    size_t count = _records.size();
+    if (!count)
+      return 0;
+    for (const auto &iter : _records)
+      Traits::Unregister(iter.first, iter.second.ref);
+    _records.clear();
+    _hotkeys.clear();
+    Traits::UninstallHandler();
+    return count;
+  }
+
+  /* Dispatch lookup. Returns HotKey() if uid is not registered */
+  HotKey find(uint32_t uid) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto iter = _hotkeys.find(uid);
+    return iter != _hotkeys.end() ? iter->second : HotKey();
+  }
+
+  bool contains(HotKey hotkey) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _records.find(hotkey) != _records.end();
+  }
+
+  /* Returns 0 if the hotkey is not registered */
+  uint32_t uid(HotKey hotkey) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto iter = _records.find(hotkey);
+    return iter != _records.end() ? iter->second.uid : 0;
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _records.size();
+  }
+
+  /* Calls fn(records) with the lock held. fn may change the refs of the records, but not the uids */
+  template<class Fn>
+  void withRecords(Fn &&fn) {
+    std::lock_guard<std::mutex> lock(_lock);
+    fn(_records);
+  }
+
+  template<class Fn>
+  void withRecords(Fn &&fn) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    fn(static_cast<const Records &>(_records));
+  }
+
+private:
+  /* 0 is never used, and a uid still registered after a wrap around is skipped */
+  uint32_t __NextUID() {
+    do {
+      if (++_uid == 0)
+        _uid = 1;
+    } while (_hotkeys.find(_uid) != _hotkeys.end());
+    return _uid;
+  }
+
+  mutable std::mutex _lock;
+  uint32_t _uid = 0;
+  Records _records;
+  std::unordered_map<uint32_t, HotKey> _hotkeys;
+};
+
+} // namespace hk
+
+#endif /* HK_HOTKEY_REGISTRY_H__ */
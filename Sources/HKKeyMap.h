@@ -18,6 +18,17 @@
 HK_EXPORT
 const UniChar kHKNilUnichar;
 
+/* Lookup statistics keys (see +[HKKeyMap lookupStatistics]) */
+HK_EXPORT
+NSString * const kHKKeyMapStatisticsCountKey;
+/* durations (NSTimeInterval), only for timed paths */
+HK_EXPORT
+NSString * const kHKKeyMapStatisticsMeanKey;
+HK_EXPORT
+NSString * const kHKKeyMapStatisticsMedianKey;
+HK_EXPORT
+NSString * const kHKKeyMapStatisticsP99Key;
+
 /*!
  @enum 		Virtual Keycodes
  @abstract Virtual KeyCode for Special keys.
@@ -232,6 +243,22 @@ typedef struct __TISInputSource* TISInputSourceRef;
 
 typedef struct __HKKeyMapContext *HKKeyMapContextRef;
 
+/*!
+ @abstract Layouts warm-up statistics.
+ @field layouts Number of enabled layouts.
+ @field compiled Number of layouts compiled by the warm-up.
+ @field failed Number of layouts that could not be compiled.
+ @field duration Wall time of the warm-up.
+ @field compileTime Cumulated compilation time of all layouts.
+ */
+typedef struct {
+  NSUInteger layouts;
+  NSUInteger compiled;
+  NSUInteger failed;
+  NSTimeInterval duration;
+  NSTimeInterval compileTime;
+} HKKeyMapWarmupStatistics;
+
 HK_OBJC_EXPORT
 @interface HKKeyMap : NSObject
 
@@ -251,6 +278,24 @@ HK_OBJC_EXPORT
 
 + (HKKeyMap *)currentKeyMap;
 
+/*!
+ @abstract Compiles all enabled keyboard layouts on low priority background threads.
+ @discussion Compiled layouts are shared by all keymaps, so switching to a warmed-up layout does not
+ have to compile it. Should be called once, at launch.
+ @param handler Called on the main queue when all layouts are compiled. May be nil.
+ */
++ (void)warmUpEnabledLayoutsWithCompletionHandler:(void (^)(HKKeyMapWarmupStatistics statistics))handler;
+
+/*!
+ @abstract Keymap lookups statistics, recorded by all threads since launch or the last reset.
+ @discussion Keys are the lookup paths ("fast path", "translate", "keys table", "layout check", "layout copy",
+ "layout load"), and values are dictionaries with the count of lookups using this path and, for timed paths,
+ the mean, median and 99th percentile durations. Percentiles are upper bounds (power of 2 nanoseconds).
+ Empty in release builds (the library is built with HK_KEYMAP_STATS=0).
+ */
++ (NSDictionary<NSString *, NSDictionary<NSString *, NSNumber *> *> *)lookupStatistics;
++ (void)resetLookupStatistics;
+
 /*!
  @result Returns a keymap instance representing the current user keymap layout.
  */
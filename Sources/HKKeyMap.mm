@@ -11,18 +11,40 @@
 #import "HKFramework.h"
 #import "HKKeymapInternal.h"
 
+#include "HKKeyMapStats.h"
+#include "HKKeyMapWarmup.h"
+#include "HKLayoutEpoch.h"
+#include "HKSpecialKeys.h"
+#include "HKStringCache.h"
+
 #import <Carbon/Carbon.h>
 
+#include <os/lock.h>
+#include <pthread.h>
+
 #pragma mark Statics Functions Declaration
 HK_INLINE
 NSString *SpecialChar(UniChar ch) {
   return [NSString stringWithCharacters:&ch length:1];
 }
 
-static
-HKKeycode HKMapGetSpecialKeyCodeForCharacter(UniChar charCode);
-static
-UniChar HKMapGetSpecialCharacterForKeycode(HKKeycode keycode);
+/* Special keys tables must match the public constants */
+#define HK_SPECIAL_KEY_CHECK(key, chr, keycode, character) \
+  static_assert(kHKVirtual##key##Key == keycode && kHK##chr##Unicode == character, #key " special key does not match public constants");
+HK_SPECIAL_KEYS(HK_SPECIAL_KEY_CHECK)
+HK_SPECIAL_KEY_ALIASES(HK_SPECIAL_KEY_CHECK)
+#undef HK_SPECIAL_KEY_CHECK
+
+static_assert(hk::kSpecialKeyInvalidKeycode == kHKInvalidVirtualKeyCode, "invalid keycode mismatch");
+
+HK_INLINE
+HKKeycode HKMapGetSpecialKeyCodeForCharacter(UniChar character) {
+  return hk::SpecialKeycodeForCharacter(character);
+}
+HK_INLINE
+UniChar HKMapGetSpecialCharacterForKeycode(HKKeycode keycode) {
+  return hk::SpecialCharacterForKeycode(keycode);
+}
 
 static
 NSString *HKMapGetModifierString(HKModifier mask);
@@ -31,27 +53,195 @@ NSString *HKMapGetSpeakableModifierString(HKModifier mask);
 static
 NSString *HKMapGetStringForUnichar(UniChar unicode);
 
+static
+NSString *HKMapGetShortcutString(UniChar character, HKModifier modifiers);
+static
+NSString *HKMapGetSpeakableShortcutString(UniChar character, HKModifier modifiers);
+
+// MARK: Layout Epoch
+/* invalidated each time the selected input source changes (see _HKKeyMapInstallLayoutObserver()) */
+static hk::LayoutEpoch sHKLayoutEpoch;
+
+uint32_t HKKeyMapGetLayoutEpoch(void) {
+  return sHKLayoutEpoch.current();
+}
+
+struct HKTISLayoutTraits {
+  typedef TISInputSourceRef Layout;
+  static TISInputSourceRef Copy() {
+    HK_KEYMAP_STATS_TIME(hk::kKeyMapProbeLayoutCopy);
+    // FIXME: we should probably use ASCII capable input source or override input source.
+    return TISCopyCurrentKeyboardLayoutInputSource();
+  }
+  static bool Equal(TISInputSourceRef a, TISInputSourceRef b) { return CFEqual(a, b); }
+  static void Release(TISInputSourceRef layout) { CFRelease(layout); }
+};
+
+typedef hk::LayoutCache<HKTISLayoutTraits> HKLayoutCache;
+
+// MARK: Shortcut Strings Cache
+struct HKStringCacheTraits {
+  typedef CFStringRef Value;
+  static void Retain(CFStringRef value) { CFRetain(value); }
+  static void Release(CFStringRef value) { CFRelease(value); }
+};
+
+typedef hk::ShortcutStringCache<HKStringCacheTraits> HKStringCache;
+
+static os_unfair_lock sHKStringCacheLock = OS_UNFAIR_LOCK_INIT;
+
+static
+HKStringCache &_HKStringCache(void) {
+  static auto *sStringCache = new HKStringCache();
+  return *sStringCache;
+}
+
+static
+NSString *_HKStringCacheGetString(UniChar character, HKModifier modifiers, hk::ShortcutStyle style) {
+  if (!character || character == kHKNilUnichar)
+    return nil;
+
+  NSString *str = nil;
+  uint64_t key = hk::ShortcutStringKey(HKKeyMapGetLayoutEpoch(), modifiers, character, style);
+  os_unfair_lock_lock(&sHKStringCacheLock);
+  /* retained before unlocking, as the entry may be evicted by an other thread */
+  str = SPXCFToNSString(_HKStringCache().lookup(key));
+  os_unfair_lock_unlock(&sHKStringCacheLock);
+  if (str)
+    return str;
+
+  switch (style) {
+    case hk::kShortcutStyleSymbolic:
+      str = HKMapGetShortcutString(character, modifiers);
+      break;
+    case hk::kShortcutStyleSpeakable:
+      str = HKMapGetSpeakableShortcutString(character, modifiers);
+      break;
+  }
+  if (str) {
+    /* cached strings are shared, so make sure they are immutable */
+    str = [str copy];
+    os_unfair_lock_lock(&sHKStringCacheLock);
+    _HKStringCache().insert(key, SPXNSToCFString(str));
+    os_unfair_lock_unlock(&sHKStringCacheLock);
+  }
+  return str;
+}
+
+NSString *HKKeyMapGetShortcutString(UniChar character, HKModifier modifiers) {
+  return _HKStringCacheGetString(character, modifiers, hk::kShortcutStyleSymbolic);
+}
+
+// MARK: Layout Hash
+/* the compilation of a uchr layout depends on the keyboard type */
+HK_INLINE
+uint64_t _HKUchrLayoutHash(CFDataRef uchr) {
+  return HKKeyMapLayoutHash(CFDataGetBytePtr(uchr), (size_t)CFDataGetLength(uchr), LMGetKbdType());
+}
+
+// MARK: Layouts Warm-up
+/* contexts compiled by the warm-up, keyed by _HKKeyMapRegistryKey() */
+static
+hk::KeyMapContextRegistry &_HKKeyMapRegistry(void) {
+  static auto *sRegistry = new hk::KeyMapContextRegistry();
+  return *sRegistry;
+}
+
+/* The identifier alone is not enough: the layout data changes when a layout is edited or reinstalled,
+ and the compiled context depends on the keyboard type. Both are part of the layout hash. */
+static
+std::string _HKKeyMapRegistryKey(NSString *identifier, uint64_t hash) {
+  char suffix[20];
+  snprintf(suffix, sizeof(suffix), "/%016llx", (unsigned long long)hash);
+  return std::string(identifier.UTF8String) + suffix;
+}
+
+struct HKUchrWarmupTraits {
+  typedef CFDataRef Layout;
+  static HKKeyMapContext *Compile(CFDataRef uchr) { return HKKeyMapContextCreateWithUchrData(uchr); }
+  static void Release(CFDataRef &uchr) { CFRelease(uchr); uchr = NULL; }
+  static void WorkerWillStart() { pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0); }
+};
+
+typedef hk::KeyMapWarmup<HKUchrWarmupTraits> HKUchrWarmup;
+
+static
+std::vector<std::pair<std::string, CFDataRef>> _HKKeyMapCopyEnabledLayouts(void) {
+  std::vector<std::pair<std::string, CFDataRef>> layouts;
+  NSDictionary *properties = @{ SPXCFToNSString(kTISPropertyInputSourceCategory): SPXCFToNSString(kTISCategoryKeyboardInputSource) };
+  CFArrayRef list = TISCreateInputSourceList(SPXNSToCFDictionary(properties), false);
+  if (!list)
+    return layouts;
+
+  for (CFIndex idx = 0, count = CFArrayGetCount(list); idx < count; idx++) {
+    TISInputSourceRef src = (TISInputSourceRef)CFArrayGetValueAtIndex(list, idx);
+    NSString *identifier = SPXCFToNSString(TISGetInputSourceProperty(src, kTISPropertyInputSourceID));
+    CFDataRef uchr = (CFDataRef)TISGetInputSourceProperty(src, kTISPropertyUnicodeKeyLayoutData);
+    /* input methods do not have layout data */
+    if (identifier && uchr)
+      layouts.emplace_back(_HKKeyMapRegistryKey(identifier, _HKUchrLayoutHash(uchr)), (CFDataRef)CFRetain(uchr));
+  }
+  CFRelease(list);
+  return layouts;
+}
+
 // MARK: -
 // MARK: HKKeyMap implementation
 
 const UniChar kHKNilUnichar = 0xffff;
 
+NSString * const kHKKeyMapStatisticsCountKey = @"count";
+NSString * const kHKKeyMapStatisticsMeanKey = @"mean";
+NSString * const kHKKeyMapStatisticsMedianKey = @"median";
+NSString * const kHKKeyMapStatisticsP99Key = @"p99";
+
 @interface HKKeyMap ()
 - (void)hk_update;
 - (void)hk_loadLayout;
 @end
 
+// MARK: Layout Observer
+static HKKeyMapLayoutObserver sHKLayoutObserver = NULL;
+
+static
+void _HKKeyMapSelectedInputSourceChanged(CFNotificationCenterRef center, void *observer, CFNotificationName name, const void *object, CFDictionaryRef userInfo) {
+  sHKLayoutEpoch.invalidate();
+  /* hk_update notifies the observer if the layout changed */
+  if (sHKLayoutObserver)
+    [[HKKeyMap currentKeyMap] hk_update];
+}
+
+/* The only layout change source: keymaps query TIS only after a notification (delivered on the main thread) */
+static
+void _HKKeyMapInstallLayoutObserver(void) {
+  static dispatch_once_t sOnce;
+  dispatch_once(&sOnce, ^{
+    CFNotificationCenterAddObserver(CFNotificationCenterGetDistributedCenter(), NULL, _HKKeyMapSelectedInputSourceChanged,
+                                    kTISNotifySelectedKeyboardInputSourceChanged, NULL, CFNotificationSuspensionBehaviorDeliverImmediately);
+  });
+}
+
+void HKKeyMapSetLayoutObserver(HKKeyMapLayoutObserver observer) {
+  sHKLayoutObserver = observer;
+  _HKKeyMapInstallLayoutObserver();
+}
+
 @implementation HKKeyMap {
 @private
   bool _autoupdate;
+  /* context owned by the warm-up registry */
+  bool _shared;
   HKKeyMapContextRef _ctxt;
-  TISInputSourceRef _layout;
+  HKLayoutCache _layout;
 }
 
 HK_INLINE
 void _HKKeyMapUpdate(HKKeyMap *self, bool load) {
-  if (self->_autoupdate)
-    [self hk_update];
+  if (self->_autoupdate) {
+    HK_KEYMAP_STATS_COUNT(hk::kKeyMapProbeLayoutCheck);
+    if (self->_layout.stale(sHKLayoutEpoch))
+      [self hk_update];
+  }
   if (!self->_ctxt && load)
     [self hk_loadLayout];
 }
@@ -69,6 +259,48 @@ void _HKKeyMapUpdate(HKKeyMap *self, bool load) {
   return currentKeyMap;
 }
 
++ (void)warmUpEnabledLayoutsWithCompletionHandler:(void (^)(HKKeyMapWarmupStatistics statistics))handler {
+  /* TIS must be used on the main thread, only the compilation is done in background */
+  auto *warmup = new HKUchrWarmup(_HKKeyMapRegistry());
+  warmup->start(_HKKeyMapCopyEnabledLayouts(), 0, [warmup, handler](const hk::WarmupStats &stats) {
+    spx_debug("%zu layouts compiled in %.2f ms (%u workers)", stats.compiled, stats.elapsed / 1e6, stats.workers);
+    HKKeyMapWarmupStatistics statistics = {
+      .layouts = stats.layouts,
+      .compiled = stats.compiled,
+      .failed = stats.failed,
+      .duration = stats.elapsed / 1e9,
+      .compileTime = stats.busy / 1e9,
+    };
+    dispatch_async(dispatch_get_main_queue(), ^{
+      /* waits for the workers to exit */
+      delete warmup;
+      if (handler)
+        handler(statistics);
+    });
+  });
+}
+
++ (NSDictionary<NSString *, NSDictionary<NSString *, NSNumber *> *> *)lookupStatistics {
+  hk::KeyMapStats stats = hk::KeyMapStatsSnapshot();
+  NSMutableDictionary *result = [[NSMutableDictionary alloc] init];
+  for (size_t idx = 0; idx < hk::kKeyMapProbeCount; idx++) {
+    const hk::KeyMapProbeStats &probe = stats.probes[idx];
+    NSMutableDictionary *entry = [[NSMutableDictionary alloc] init];
+    entry[kHKKeyMapStatisticsCountKey] = @(probe.count);
+    if (probe.samples) {
+      entry[kHKKeyMapStatisticsMeanKey] = @(probe.mean() / 1e9);
+      entry[kHKKeyMapStatisticsMedianKey] = @(probe.percentile(.5) / 1e9);
+      entry[kHKKeyMapStatisticsP99Key] = @(probe.percentile(.99) / 1e9);
+    }
+    result[@(hk::KeyMapProbeName(static_cast<hk::KeyMapProbe>(idx)))] = entry;
+  }
+  return result;
+}
+
++ (void)resetLookupStatistics {
+  hk::KeyMapStatsReset();
+}
+
 static
 void _ShowTISPalette(CFStringRef name, NSString *identifier) {
   NSDictionary *properties = @{ SPXCFToNSString(kTISPropertyInputSourceType): SPXCFToNSString(name),
@@ -118,39 +350,17 @@ void _ShowTISPalette(CFStringRef name, NSString *identifier) {
 }
 
 + (NSString *)stringRepresentationForCharacter:(UniChar)character modifiers:(HKModifier)modifiers {
-  if (character && character != kHKNilUnichar) {
-    NSString *str = nil;
-    NSString *mod = HKMapGetModifierString(modifiers);
-    if (modifiers & kCGEventFlagMaskNumericPad) {
-      if (character >= '0' && character <= '9') {
-        UniChar chrs[2] = { character, '*' };
-        str = [NSString stringWithCharacters:chrs length:2];
-      }
-    }
-    if ([mod length] > 0) {
-      return [mod stringByAppendingString:str ? : HKMapGetStringForUnichar(character)];
-    } else {
-      return str ? : HKMapGetStringForUnichar(character);
-    }
-  }
-  return nil;
+  return _HKStringCacheGetString(character, modifiers, hk::kShortcutStyleSymbolic);
 }
 
 + (NSString *)speakableStringRepresentationForCharacter:(UniChar)character modifiers:(HKModifier)modifiers {
-  if (character && character != kHKNilUnichar) {
-    NSString *mod = HKMapGetSpeakableModifierString(modifiers);
-    if ([mod length] > 0) {
-      return [NSString stringWithFormat:@"%@ + %@", mod, HKMapGetStringForUnichar(character)];
-    } else {
-      return HKMapGetStringForUnichar(character);
-    }
-  }
-  return nil;
+  return _HKStringCacheGetString(character, modifiers, hk::kShortcutStyleSpeakable);
 }
 
 - (instancetype)init {
   if (self = [super init]) {
     _autoupdate = true;
+    _HKKeyMapInstallLayoutObserver();
   }
   return self;
 }
@@ -158,26 +368,25 @@ void _ShowTISPalette(CFStringRef name, NSString *identifier) {
 HK_INLINE
 void _HKKeyMapResetContext(HKKeyMap *self) {
   if (self->_ctxt) {
-    HKKeyMapContextDealloc(self->_ctxt);
-    free(self->_ctxt);
+    if (!self->_shared)
+      HKKeyMapContextDealloc(self->_ctxt);
     self->_ctxt = NULL;
+    self->_shared = false;
   }
 }
 
 - (void)dealloc {
   _HKKeyMapResetContext(self);
-  if (_layout)
-    CFRelease(_layout);
 }
 
 - (NSString *)identifier {
   _HKKeyMapUpdate(self, false);
-  return SPXCFToNSString(TISGetInputSourceProperty(_layout, kTISPropertyInputSourceID));
+  return SPXCFToNSString(TISGetInputSourceProperty(_layout.layout(), kTISPropertyInputSourceID));
 }
 
 - (NSString *)localizedName {
   _HKKeyMapUpdate(self, false);
-  return SPXCFToNSString(TISGetInputSourceProperty(_layout, kTISPropertyInputSourceLanguages));
+  return SPXCFToNSString(TISGetInputSourceProperty(_layout.layout(), kTISPropertyInputSourceLanguages));
 }
 
 - (HKKeycode)keycodeForCharacter:(UniChar)character modifiers:(HKModifier *)modifiers {
@@ -237,22 +446,37 @@ void _HKKeyMapResetContext(HKKeyMap *self) {
 }
 
 - (void)hk_update {
-  CFBooleanRef selected = TISGetInputSourceProperty(_layout, kTISPropertyInputSourceIsSelected);
-  if (!selected || !CFBooleanGetValue(selected)) {
-    // FIXME: we should probably use ASCII capable input source or override input source.
-    TISInputSourceRef current = TISCopyCurrentKeyboardLayoutInputSource();
-    if (current != _layout) { // FIXME: compare _identifier instead
-      _HKKeyMapResetContext(self);
-      if (_layout)
-        CFRelease(_layout);
-      _layout = current;
-    }
+  /* queries TIS only if the layout changed since the last update, and releases the copy if it is the same layout */
+  if (!_layout.update(sHKLayoutEpoch))
+    return;
+
+  /* the previous context is kept until the observer has been notified */
+  HKKeyMapContextRef previous = _ctxt;
+  bool shared = _shared;
+  _ctxt = NULL;
+  _shared = false;
+
+  if (previous && sHKLayoutObserver && self == [HKKeyMap currentKeyMap]) {
+    [self hk_loadLayout];
+    if (_ctxt)
+      sHKLayoutObserver(previous, _ctxt);
   }
+  if (previous && !shared)
+    HKKeyMapContextDealloc(previous);
 }
 
 - (void)hk_loadLayout {
   spx_assert(_ctxt == NULL, "trying to reinit keymap context");
-  CFDataRef uchr = TISGetInputSourceProperty(_layout, kTISPropertyUnicodeKeyLayoutData);
+  HK_KEYMAP_STATS_TIME(hk::kKeyMapProbeLayoutLoad);
+  /* baked layouts are XKB only (see HKKeyMapBaked.h): uchr layouts are compiled at runtime or by the warm-up */
+  CFDataRef uchr = (CFDataRef)TISGetInputSourceProperty(_layout.layout(), kTISPropertyUnicodeKeyLayoutData);
+  NSString *identifier = SPXCFToNSString(TISGetInputSourceProperty(_layout.layout(), kTISPropertyInputSourceID));
+  /* hashes the layout data only if the warm-up published something */
+  hk::KeyMapContextRegistry &registry = _HKKeyMapRegistry();
+  if (identifier && uchr && registry.size() && (_ctxt = registry.lookup(_HKKeyMapRegistryKey(identifier, _HKUchrLayoutHash(uchr))))) {
+    _shared = true;
+    return;
+  }
   if (uchr) {
     _ctxt = HKKeyMapContextCreateWithUchrData(uchr);
   } else {
@@ -264,163 +488,32 @@ void _HKKeyMapResetContext(HKKeyMap *self) {
 
 #pragma mark -
 #pragma mark Statics Functions Definition
-HKKeycode HKMapGetSpecialKeyCodeForCharacter(UniChar character) {
-  switch (character) {
-      /* functions keys */
-    case kHKF1Unicode:
-      return kHKVirtualF1Key;
-    case kHKF2Unicode:
-      return kHKVirtualF2Key;
-    case kHKF3Unicode:
-      return kHKVirtualF3Key;
-    case kHKF4Unicode:
-      return kHKVirtualF4Key;
-      /* functions keys */
-    case kHKF5Unicode:
-      return kHKVirtualF5Key;
-    case kHKF6Unicode:
-      return kHKVirtualF6Key;
-    case kHKF7Unicode:
-      return kHKVirtualF7Key;
-    case kHKF8Unicode:
-      return kHKVirtualF8Key;
-      /* functions keys */
-    case kHKF9Unicode:
-      return kHKVirtualF9Key;
-    case kHKF10Unicode:
-      return kHKVirtualF10Key;
-    case kHKF11Unicode:
-      return kHKVirtualF11Key;
-    case kHKF12Unicode:
-      return kHKVirtualF12Key;
-      /* functions keys */
-    case kHKF13Unicode:
-      return kHKVirtualF13Key;
-    case kHKF14Unicode:
-      return kHKVirtualF14Key;
-    case kHKF15Unicode:
-      return kHKVirtualF15Key;
-    case kHKF16Unicode:
-      return kHKVirtualF16Key;
-      /* aluminium keyboard */
-    case kHKF17Unicode:
-      return kHKVirtualF17Key;
-    case kHKF18Unicode:
-      return kHKVirtualF18Key;
-    case kHKF19Unicode:
-      return kHKVirtualF19Key;
-//    case kHKF20Unicode: return ;
-//    case kHKF21Unicode: return ;
-//    case kHKF22Unicode: return ;
-//    case kHKF23Unicode: return ;
-//    case kHKF24Unicode: return ;
-//    case kHKF25Unicode: return ;
-//    case kHKF26Unicode: return ;
-//    case kHKF27Unicode: return ;
-//    case kHKF28Unicode: return ;
-//    case kHKF29Unicode: return ;
-//    case kHKF30Unicode: return ;
-//    case kHKF31Unicode: return ;
-//    case kHKF32Unicode: return ;
-//    case kHKF33Unicode: return ;
-//    case kHKF34Unicode: return ;
-//    case kHKF35Unicode: return ;
-      /* editing utility keys */
-    case kHKHelpUnicode:
-      return kHKVirtualHelpKey;
-//    case kHKInsertUnicode:
-//      return ;
-    case kHKDeleteUnicode:
-      return kHKVirtualDeleteKey;
-    case kHKTabUnicode:
-      return kHKVirtualTabKey;
-    case kHKEnterUnicode:
-      return kHKVirtualEnterKey;
-    case kHKReturnUnicode:
-      return kHKVirtualReturnKey;
-    case kHKEscapeUnicode:
-      return kHKVirtualEscapeKey;
-    case kHKForwardDeleteUnicode:
-      return kHKVirtualForwardDeleteKey;
-      /* navigation keys */
-    case kHKHomeUnicode:
-      return kHKVirtualHomeKey;
-//    case kHKBeginUnicode:
-//      return ;
-    case kHKEndUnicode:
-      return kHKVirtualEndKey;
-    case kHKPageUpUnicode:
-      return kHKVirtualPageUpKey;
-    case kHKPageDownUnicode:
-      return kHKVirtualPageDownKey;
-    case kHKLeftArrowUnicode:
-      return kHKVirtualLeftArrowKey;
-    case kHKRightArrowUnicode:
-      return kHKVirtualRightArrowKey;
-    case kHKUpArrowUnicode:
-      return kHKVirtualUpArrowKey;
-    case kHKDownArrowUnicode:
-      return kHKVirtualDownArrowKey;
-    case kHKClearLineUnicode:
-      return kHKVirtualClearLineKey;
-    case kHKNoBreakSpaceUnicode:
-      return kHKVirtualSpaceKey;
+#pragma mark String representation
+NSString *HKMapGetShortcutString(UniChar character, HKModifier modifiers) {
+  NSString *str = nil;
+  NSString *mod = HKMapGetModifierString(modifiers);
+  if (modifiers & kCGEventFlagMaskNumericPad) {
+    if (character >= '0' && character <= '9') {
+      UniChar chrs[2] = { character, '*' };
+      str = [NSString stringWithCharacters:chrs length:2];
+    }
+  }
+  if ([mod length] > 0) {
+    return [mod stringByAppendingString:str ? : HKMapGetStringForUnichar(character)];
+  } else {
+    return str ? : HKMapGetStringForUnichar(character);
   }
-  return kHKInvalidVirtualKeyCode;
 }
 
-UniChar HKMapGetSpecialCharacterForKeycode(HKKeycode keycode) {
-  switch (keycode) {
-    case kHKInvalidVirtualKeyCode: return kHKNilUnichar;
-      /* functions keys */
-    case kHKVirtualF1Key: return kHKF1Unicode;
-    case kHKVirtualF2Key: return kHKF2Unicode;
-    case kHKVirtualF3Key: return kHKF3Unicode;
-    case kHKVirtualF4Key: return kHKF4Unicode;
-      /* functions keys */
-    case kHKVirtualF5Key: return kHKF5Unicode;
-    case kHKVirtualF6Key: return kHKF6Unicode;
-    case kHKVirtualF7Key: return kHKF7Unicode;
-    case kHKVirtualF8Key: return kHKF8Unicode;
-      /* functions keys */
-    case kHKVirtualF9Key:  return kHKF9Unicode;
-    case kHKVirtualF10Key: return kHKF10Unicode;
-    case kHKVirtualF11Key: return kHKF11Unicode;
-    case kHKVirtualF12Key: return kHKF12Unicode;
-      /* functions keys */
-    case kHKVirtualF13Key: return kHKF13Unicode;
-    case kHKVirtualF14Key: return kHKF14Unicode;
-    case kHKVirtualF15Key: return kHKF15Unicode;
-    case kHKVirtualF16Key: return kHKF16Unicode;
-      /* aluminium keyboard */
-    case kHKVirtualF17Key: return kHKF17Unicode;
-    case kHKVirtualF18Key: return kHKF18Unicode;
-    case kHKVirtualF19Key: return kHKF19Unicode;
-      /* editing utility keys */
-    case kHKVirtualHomeKey:          return kHKHomeUnicode;
-    case kHKVirtualEndKey:           return kHKEndUnicode;
-    case kHKVirtualPageUpKey:        return kHKPageUpUnicode;
-    case kHKVirtualPageDownKey:      return kHKPageDownUnicode;
-    case kHKVirtualHelpKey:          return kHKHelpUnicode;
-    case kHKVirtualForwardDeleteKey: return kHKForwardDeleteUnicode;
-      /* navigation keys */
-    case kHKVirtualLeftArrowKey:  return kHKLeftArrowUnicode;
-    case kHKVirtualRightArrowKey: return kHKRightArrowUnicode;
-    case kHKVirtualUpArrowKey:    return kHKUpArrowUnicode;
-    case kHKVirtualDownArrowKey:  return kHKDownArrowUnicode;
-      /* special num-pad key */
-    case kHKVirtualClearLineKey:  return kHKClearLineUnicode;
-      /* key with special representation */
-    case kHKVirtualEnterKey:  return kHKEnterUnicode;
-    case kHKVirtualTabKey:    return kHKTabUnicode;
-    case kHKVirtualReturnKey: return kHKReturnUnicode;
-    case kHKVirtualDeleteKey: return kHKDeleteUnicode;
-    case kHKVirtualEscapeKey: return kHKEscapeUnicode;
+NSString *HKMapGetSpeakableShortcutString(UniChar character, HKModifier modifiers) {
+  NSString *mod = HKMapGetSpeakableModifierString(modifiers);
+  if ([mod length] > 0) {
+    return [NSString stringWithFormat:@"%@ + %@", mod, HKMapGetStringForUnichar(character)];
+  } else {
+    return HKMapGetStringForUnichar(character);
   }
-  return kHKNilUnichar;
 }
 
-#pragma mark String representation
 NSString* HKMapGetModifierString(HKModifier mask) {
   UniChar modifier[5];
   UniChar *symbol = modifier;
@@ -0,0 +1,95 @@
+/*
+ *  HKKeyMapBaked.cpp
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#include "HKKeyMapBaked.h"
+
+#include "HKKeyMapBakedLayouts.inc"
+
+namespace {
+
+constexpr size_t kBakedLayoutCount = sizeof(hk::kBakedLayouts) / sizeof(*hk::kBakedLayouts) - 1;
+
+/* Modifiers used to build the keys table of contexts using translate(). Other modifiers are ignored by the keys lookup. */
+const HKModifier kBakedModifiers[] = {
+  0,
+  kCGEventFlagMaskShift,
+  kCGEventFlagMaskAlphaShift,
+  kCGEventFlagMaskAlternate,
+  kCGEventFlagMaskShift | kCGEventFlagMaskAlphaShift,
+  kCGEventFlagMaskShift | kCGEventFlagMaskAlternate,
+  kCGEventFlagMaskAlphaShift | kCGEventFlagMaskAlternate,
+  kCGEventFlagMaskShift | kCGEventFlagMaskAlphaShift | kCGEventFlagMaskAlternate,
+};
+
+template<class Map>
+std::vector<hk::BakedEntry> _HKBakeTable(const Map &map) {
+  std::vector<hk::BakedEntry> table;
+  table.reserve(map.size());
+  for (const auto &entry : map)
+    table.push_back({ entry.first, entry.second });
+  std::sort(table.begin(), table.end(), [](const hk::BakedEntry &lhs, const hk::BakedEntry &rhs) { return lhs.key < rhs.key; });
+  return table;
+}
+
+}
+
+HKKeyMapContext *HKKeyMapContextGetBaked(uint64_t hash) {
+  /* static storage: empty tables do not allocate */
+  static HKKeyMapContext sContexts[kBakedLayoutCount + 1];
+  static bool sInitialized = [] {
+    for (size_t idx = 0; idx < kBakedLayoutCount; idx++) {
+      sContexts[idx].baked = hk::kBakedLayouts[idx];
+      memcpy(sContexts[idx].map, hk::kBakedLayouts[idx]->map, sizeof(sContexts[idx].map));
+    }
+    return true;
+  }();
+  (void)sInitialized;
+
+  for (size_t idx = 0; idx < kBakedLayoutCount; idx++) {
+    if (hk::kBakedLayouts[idx]->hash == hash)
+      return &sContexts[idx];
+  }
+  return NULL;
+}
+
+hk::BakedTables hk::BakeContext(const HKKeyMapContext *ctxt) {
+  BakedTables tables;
+  memcpy(tables.map, ctxt->map, sizeof(tables.map));
+  if (ctxt->baked) {
+    const BakedLayout *layout = ctxt->baked;
+    tables.chars.assign(layout->chars, layout->chars + layout->charCount);
+    tables.states.assign(layout->states, layout->states + layout->stateCount);
+    tables.keys.assign(layout->keys, layout->keys + layout->keyCount);
+    return tables;
+  }
+
+  tables.chars = _HKBakeTable(ctxt->chars);
+  tables.states = _HKBakeTable(ctxt->stats);
+  if (ctxt->translate) {
+    std::unordered_map<uint32_t, UniChar> keys;
+    for (HKModifier modifier : kBakedModifiers) {
+      for (HKKeycode keycode = 0; keycode < 128; keycode++) {
+        UniChar chr = ctxt->translate(ctxt, keycode, modifier);
+        if (chr != kKeyMapNilCharacter)
+          keys.emplace(__HKUtilsFlatKey(keycode, modifier, 0), chr);
+      }
+    }
+    tables.keys = _HKBakeTable(keys);
+  } else {
+    tables.keys = _HKBakeTable(ctxt->keys);
+  }
+  return tables;
+}
+
+bool hk::BakedTablesEqual(const BakedTables &lhs, const BakedTables &rhs) {
+  auto equal = [](const std::vector<BakedEntry> &l, const std::vector<BakedEntry> &r) {
+    return l.size() == r.size() && (l.empty() || memcmp(l.data(), r.data(), l.size() * sizeof(BakedEntry)) == 0);
+  };
+  return memcmp(lhs.map, rhs.map, sizeof(lhs.map)) == 0 &&
+    equal(lhs.chars, rhs.chars) && equal(lhs.states, rhs.states) && equal(lhs.keys, rhs.keys);
+}
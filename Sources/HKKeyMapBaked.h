@@ -0,0 +1,99 @@
+/*
+ *  HKKeyMapBaked.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_KEYMAP_BAKED_H__)
+#define HK_KEYMAP_BAKED_H__ 1
+
+#include "HKKeyMapContext.h"
+
+/*
+ Build time compiled layouts.
+
+ Common layouts are compiled by Tools/HKKeyMapBake into read-only sorted tables
+ (HKKeyMapBakedLayouts.inc). A baked layout is identified by the hash of the data it was compiled
+ from, so loading a layout whose data hash matches a baked layout does not compile anything and
+ does not allocate.
+
+ This is a XKB only feature: uchr layouts are provided by the system and change with the OS
+ version and the keyboard type, so they are not baked. HKKeyMapBaked.cpp is not part of the
+ framework, it is linked by XKB builds (see HKKeyMapXKB.h), the tools and the tests.
+
+ Dead keys are resolved using the compose table of the locale, so a keymap with dead keys is
+ baked once per locale passed to the tool, and is compiled at runtime when loaded with another
+ locale. A keymap without dead keys does not depend on the locale and is baked once.
+ */
+
+/*!
+ @function
+ @result     Returns a static context, or NULL if no layout was baked for this hash.
+ HKKeyMapContextDealloc() does nothing for static contexts.
+ */
+HK_PRIVATE
+HKKeyMapContext *HKKeyMapContextGetBaked(uint64_t hash);
+
+#if defined(__cplusplus)
+
+#include <algorithm>
+#include <vector>
+
+namespace hk {
+
+/* chars: character -> flat keystroke, states: dead state -> flat keystroke, keys: flat keystroke -> character */
+struct BakedEntry {
+  uint32_t key;
+  uint32_t value;
+};
+static_assert(sizeof(BakedEntry) == 8, "baked entries must not have padding");
+
+struct BakedLayout {
+  const char *name;
+  /* compose table locale, empty for keymaps without dead keys */
+  const char *locale;
+  uint64_t hash;
+  UniChar map[128];
+  /* sorted by key */
+  const BakedEntry *chars;
+  uint32_t charCount;
+  const BakedEntry *states;
+  uint32_t stateCount;
+  const BakedEntry *keys;
+  uint32_t keyCount;
+};
+
+/* null terminated */
+extern const BakedLayout *const kBakedLayouts[];
+
+HK_INLINE
+const BakedEntry *BakedFind(const BakedEntry *entries, uint32_t count, uint32_t key) {
+  const BakedEntry *end = entries + count;
+  const BakedEntry *entry = std::lower_bound(entries, end, key, [](const BakedEntry &e, uint32_t k) { return e.key < k; });
+  return entry != end && entry->key == key ? entry : nullptr;
+}
+
+/* Canonical (sorted) form of a context tables */
+struct BakedTables {
+  UniChar map[128];
+  std::vector<BakedEntry> chars;
+  std::vector<BakedEntry> states;
+  std::vector<BakedEntry> keys;
+};
+
+/*
+ Works with runtime and baked contexts. When the context has a translate function (uchr),
+ the keys table is built using it, as a baked context cannot translate keystrokes.
+ */
+BakedTables BakeContext(const HKKeyMapContext *ctxt);
+
+/* Byte-for-byte comparison */
+bool BakedTablesEqual(const BakedTables &lhs, const BakedTables &rhs);
+
+} // namespace hk
+
+#endif /* __cplusplus */
+
+#endif /* HK_KEYMAP_BAKED_H__ */
@@ -0,0 +1,211 @@
+/*
+ *  HKKeyMapContext.cpp
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#include "HKKeyMapContext.h"
+#include "HKKeyMapBaked.h"
+#include "HKKeyMapStats.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+// MARK: Tables
+/* All lookups return 0 (invalid flat key) or kKeyMapNilCharacter if not found */
+HK_INLINE
+uint32_t __HKContextCharacterKeystroke(const HKKeyMapContext *ctxt, UniChar character) {
+  if (ctxt->baked) {
+    const hk::BakedEntry *entry = hk::BakedFind(ctxt->baked->chars, ctxt->baked->charCount, character);
+    return entry ? entry->value : 0;
+  }
+  auto iter = ctxt->chars.find(character);
+  return iter != ctxt->chars.end() ? iter->second : 0;
+}
+
+HK_INLINE
+uint32_t __HKContextStateKeystroke(const HKKeyMapContext *ctxt, uint16_t state) {
+  if (ctxt->baked) {
+    const hk::BakedEntry *entry = hk::BakedFind(ctxt->baked->states, ctxt->baked->stateCount, state);
+    return entry ? entry->value : 0;
+  }
+  auto iter = ctxt->stats.find(state);
+  return iter != ctxt->stats.end() ? iter->second : 0;
+}
+
+HK_INLINE
+UniChar __HKContextKeystrokeCharacter(const HKKeyMapContext *ctxt, uint32_t flat) {
+  if (ctxt->baked) {
+    const hk::BakedEntry *entry = hk::BakedFind(ctxt->baked->keys, ctxt->baked->keyCount, flat);
+    return entry ? static_cast<UniChar>(entry->value) : hk::kKeyMapNilCharacter;
+  }
+  auto iter = ctxt->keys.find(flat);
+  return iter != ctxt->keys.end() ? iter->second : hk::kKeyMapNilCharacter;
+}
+
+// MARK: -
+
+UniChar HKCharacterForKeyCodeFunction(HKKeyMapContext *ctxt, HKKeycode keycode, HKModifier modifiers) {
+  // fast path (does not works for dead key)
+  if (!modifiers && keycode < 128 && ctxt->map[keycode] != hk::kKeyMapNilCharacter) {
+    HK_KEYMAP_STATS_COUNT(hk::kKeyMapProbeFastPath);
+    return ctxt->map[keycode];
+  }
+  if (ctxt->translate) {
+    HK_KEYMAP_STATS_SAMPLE(hk::kKeyMapProbeTranslate);
+    return ctxt->translate(ctxt, keycode, modifiers);
+  }
+  if (keycode >= 128)
+    return hk::kKeyMapNilCharacter;
+
+  HK_KEYMAP_STATS_SAMPLE(hk::kKeyMapProbeKeysTable);
+  /* modifiers that does not change the output are not part of the table */
+  UniChar unicode = __HKContextKeystrokeCharacter(ctxt, __HKUtilsFlatKey(keycode, modifiers, 0));
+  if (unicode == hk::kKeyMapNilCharacter)
+    unicode = __HKContextKeystrokeCharacter(ctxt, __HKUtilsFlatKey(keycode, modifiers & (kCGEventFlagMaskShift | kCGEventFlagMaskAlphaShift | kCGEventFlagMaskAlternate), 0));
+  return unicode;
+}
+
+size_t HKKeycodesForCharacterFunction(HKKeyMapContext *ctxt, UniChar character, HKKeycode *keys, HKModifier *modifiers, size_t maxsize) {
+  size_t count = 0;
+  size_t limit = 10;
+  HKKeycode ikeys[10];
+  HKModifier imodifiers[10];
+
+  uint16_t d = 0;
+  HKKeycode k = 0;
+  HKModifier m = 0;
+  uint32_t flat = __HKContextCharacterKeystroke(ctxt, character);
+  while (flat && count < limit) {
+    __HKUtilsDeflatKey(flat, &k, &m, &d);
+    ikeys[count] = k;
+    imodifiers[count] = m;
+    count++;
+    flat = d ? __HKContextStateKeystroke(ctxt, d) : 0;
+    /* a dead state that cannot be entered: the sequence would not output the character */
+    if (d && !flat)
+      return 0;
+  }
+  /* the sequence does not start in the state 0 (too long, or a loop in a hand made context) */
+  if (flat)
+    return 0;
+  size_t idx = 0;
+  while (idx < count && idx < maxsize) {
+    keys[idx] = ikeys[count - idx - 1];
+    modifiers[idx] = imodifiers[count - idx - 1];
+    idx++;
+  }
+  return count;
+}
+
+void HKKeyMapContextDealloc(HKKeyMapContext *ctxt) {
+  /* baked contexts are static */
+  if (ctxt->baked)
+    return;
+  if (ctxt->dispose)
+    ctxt->dispose(ctxt);
+  delete ctxt;
+}
+
+uint64_t HKKeyMapLayoutHash(const void *data, size_t length, uint64_t seed) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t idx = 0; idx < sizeof(seed); idx++) {
+    hash ^= (seed >> (idx * 8)) & 0xff;
+    hash *= 0x100000001b3ULL;
+  }
+  /* layout data are large: hash 8 bytes at a time */
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  size_t idx = 0;
+  for (; idx + sizeof(uint64_t) <= length; idx += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bytes + idx, sizeof(word));
+    hash ^= word;
+    hash *= 0x100000001b3ULL;
+  }
+  for (; idx < length; idx++) {
+    hash ^= bytes[idx];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// MARK: Planner
+void hk::KeystrokePlanner::addOutput(uint16_t from, HKKeycode code, HKModifier modifier, UniChar character) {
+  if (from > 0x3fff || character == kKeyMapNilCharacter)
+    return;
+  _outputs.push_back({ from, character, __HKUtilsFlatKey(code, modifier, 0), __Cost(modifier, false) });
+}
+
+void hk::KeystrokePlanner::addTransition(uint16_t from, HKKeycode code, HKModifier modifier, uint16_t to) {
+  /* dead states are 14 bits in flat keys, and a transition to the state 0 is not a dead key */
+  if (!to || to > 0x3fff || from > 0x3fff)
+    return;
+  _transitions.push_back({ from, to, __HKUtilsFlatKey(code, modifier, 0), __Cost(modifier, true) });
+}
+
+void hk::KeystrokePlanner::compile(HKKeyMapContext *ctxt) const {
+  constexpr uint32_t kUnreachable = UINT32_MAX;
+  uint16_t states = 1;
+  for (const Edge &edge : _transitions)
+    states = std::max<uint16_t>(states, static_cast<uint16_t>(std::max(edge.from, edge.to) + 1));
+
+  /* transitions by source state, in insertion order */
+  std::vector<uint32_t> first(states + 1, 0);
+  for (const Edge &edge : _transitions)
+    first[edge.from + 1]++;
+  for (size_t idx = 1; idx <= states; idx++)
+    first[idx] += first[idx - 1];
+  std::vector<uint32_t> edges(_transitions.size());
+  std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+  for (uint32_t idx = 0; idx < _transitions.size(); idx++)
+    edges[fill[_transitions[idx].from]++] = idx;
+
+  /* shortest paths from the state 0. On equal cost, the lowest flat keystroke enters a state */
+  std::vector<uint32_t> cost(states, kUnreachable);
+  std::vector<uint32_t> entry(states, 0); // state -> flat keystroke (with the previous state) entering it
+  typedef std::pair<uint32_t, uint16_t> Pending;
+  std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> pending;
+  cost[0] = 0;
+  pending.push({ 0, 0 });
+  while (!pending.empty()) {
+    Pending top = pending.top();
+    pending.pop();
+    if (top.first != cost[top.second])
+      continue; // already settled with a lower cost
+    for (uint32_t idx = first[top.second]; idx < first[top.second + 1]; idx++) {
+      const Edge &edge = _transitions[edges[idx]];
+      uint32_t next = top.first + edge.cost;
+      uint32_t flat = __HKUtilsFlatDead(edge.flat, edge.from);
+      if (next < cost[edge.to]) {
+        cost[edge.to] = next;
+        entry[edge.to] = flat;
+        pending.push({ next, edge.to });
+      } else if (next == cost[edge.to] && flat < entry[edge.to]) {
+        /* same cost, so the states reached from edge.to are not affected */
+        entry[edge.to] = flat;
+      }
+    }
+  }
+
+  ctxt->stats.clear();
+  for (uint16_t state = 1; state < states; state++) {
+    if (cost[state] != kUnreachable)
+      ctxt->stats[state] = entry[state];
+  }
+
+  ctxt->chars.clear();
+  std::unordered_map<uint16_t, uint32_t> best;
+  for (const Edge &edge : _outputs) {
+    if (edge.from >= states || cost[edge.from] == kUnreachable)
+      continue;
+    uint32_t total = cost[edge.from] + edge.cost;
+    auto iter = best.try_emplace(edge.to, total);
+    if (iter.second || total < iter.first->second) {
+      iter.first->second = total;
+      ctxt->chars[edge.to] = __HKUtilsFlatDead(edge.flat, edge.from);
+    }
+  }
+}
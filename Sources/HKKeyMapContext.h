@@ -0,0 +1,243 @@
+/*
+ *  HKKeyMapContext.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_KEYMAP_CONTEXT_H__)
+#define HK_KEYMAP_CONTEXT_H__ 1
+
+/*
+ Compiled keymap context.
+
+ The context and its lookup functions do not depend on any macOS framework, so the same lookup
+ engine is used by every layout backend: uchr data (HKKeymapInternal.mm) on macOS, and XKB keymaps
+ (HKKeyMapXKB.cpp) on other platforms.
+ Keycodes are always macOS virtual keycodes, and modifiers are native (kCGEventFlagMask) modifiers.
+ */
+
+#if defined(__APPLE__)
+#  include <HotKeyToolKit/HKBase.h>
+#else
+#  include "HKDefine.h"
+
+#  include <stdint.h>
+
+typedef uint16_t UniChar;
+typedef uint16_t HKKeycode;
+typedef uint32_t HKModifier;
+
+/* CGEventFlags values */
+enum {
+  kCGEventFlagMaskAlphaShift = 0x00010000,
+  kCGEventFlagMaskShift = 0x00020000,
+  kCGEventFlagMaskControl = 0x00040000,
+  kCGEventFlagMaskAlternate = 0x00080000,
+  kCGEventFlagMaskCommand = 0x00100000,
+  kCGEventFlagMaskHelp = 0x00400000,
+  kCGEventFlagMaskSecondaryFn = 0x00800000,
+  kCGEventFlagMaskNumericPad = 0x00200000,
+};
+#endif
+
+#include <stddef.h>
+
+typedef struct __HKKeyMapContext HKKeyMapContext;
+
+HK_PRIVATE
+UniChar HKCharacterForKeyCodeFunction(HKKeyMapContext *ctxt, HKKeycode keycode, HKModifier modifier);
+
+HK_PRIVATE
+size_t HKKeycodesForCharacterFunction(HKKeyMapContext *ctxt, UniChar character, HKKeycode *keys, HKModifier *modifiers, size_t maxsize);
+
+HK_PRIVATE
+void HKKeyMapContextDealloc(HKKeyMapContext *ctxt);
+
+/*!
+ @function
+ @abstract   FNV-1a based hash of a layout data (8 bytes words).
+ @param      seed Identifies the compilation parameters (keyboard type, compose locale, …).
+ */
+HK_PRIVATE
+uint64_t HKKeyMapLayoutHash(const void *data, size_t length, uint64_t seed);
+
+#if defined(__cplusplus)
+
+#include <assert.h>
+#include <string.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace hk {
+constexpr UniChar kKeyMapNilCharacter = 0xffff;
+
+struct BakedLayout;
+}
+
+struct __HKKeyMapContext {
+  /* keycode -> character without modifier (fast path) */
+  UniChar map[128];
+  /* character -> flat keystroke. The dead state of the keystroke is the state required to get the character */
+  std::unordered_map<uint16_t, uint32_t> chars;
+  /* dead state -> flat keystroke used to enter this state */
+  std::unordered_map<uint16_t, uint32_t> stats;
+  /* flat keystroke (without dead state) -> character. Used when the backend does not provide translate() */
+  std::unordered_map<uint32_t, UniChar> keys;
+
+  /* Backend specific */
+  UniChar (*translate)(const HKKeyMapContext *ctxt, HKKeycode keycode, HKModifier modifier) = nullptr;
+  void (*dispose)(HKKeyMapContext *ctxt) = nullptr;
+  const void *info = nullptr;
+
+  /* Build time compiled layout (see HKKeyMapBaked.h). When set, the tables above are empty and the context is static. */
+  const hk::BakedLayout *baked = nullptr;
+
+  __HKKeyMapContext() {
+    /* set nil unichar in all blocks */
+    memset(map, 0xff, sizeof(map));
+  }
+};
+
+// MARK: Flat and deflate
+/* Flat format:
+-----------------------------------------------------------------
+| dead state (14 bits) | modifiers (10 bits) | keycode (8 bits) |
+-----------------------------------------------------------------
+Note: keycode = 0xff => keycode is 0.
+*/
+
+HK_INLINE
+uint32_t __HKUtilsFlatKey(HKKeycode code, HKModifier modifier, uint32_t dead) {
+  assert(code < 128 && "invalid value");
+  /* We change keycode 0 to 0xff, so the return value is never 0, as flat == 0 mean invalid */
+  /* modifier: modifier use only 16 high bits and 0x3ff00 is 0x3ff << 8 */
+  return ((code ? code : 0xff) & 0xff) | ((modifier >> 8) & 0x3ff00) | (dead & 0x3fff) << 18;
+}
+HK_INLINE
+uint32_t __HKUtilsFlatDead(uint32_t flat, uint32_t dead) {
+  return (flat & 0x3ffff) | ((dead & 0x3fff) << 18);
+}
+HK_INLINE
+void __HKUtilsDeflatKey(uint32_t flat, HKKeycode *code, HKModifier *modifier, uint16_t *dead) {
+  if (code) {
+    *code = flat & 0xff;
+    if (*code == 0xff) *code = 0;
+  }
+  if (modifier) *modifier = (HKModifier)(flat & 0x3ff00) << 8;
+  if (dead) *dead = (flat >> 18) & 0x3fff;
+}
+
+HK_INLINE
+uint32_t __GetNativeModifierCount(HKModifier idx) {
+  uint32_t count = 0;
+  if (idx & kCGEventFlagMaskShift) count++;
+  if (idx & kCGEventFlagMaskControl) count++;
+  if (idx & kCGEventFlagMaskCommand) count++;
+  if (idx & kCGEventFlagMaskAlternate) count++;
+  if (idx & kCGEventFlagMaskAlphaShift) count++;
+  return count;
+}
+
+// MARK: Builder
+HK_INLINE
+bool __HKMapInsertIfBetter(std::unordered_map<uint16_t, uint32_t> &table, uint16_t key, HKKeycode code, HKModifier modifier, uint32_t dead) {
+  auto res = table.try_emplace(key, __HKUtilsFlatKey(code, modifier, dead));
+  if (res.second) // if this was a new entry -> we are done
+    return true;
+
+  /* retreive previous modifier */
+  HKModifier m = 0;
+  __HKUtilsDeflatKey(res.first->second, NULL, &m, NULL);
+  /* if new modifier uses less key than the previous one */
+  if (__GetNativeModifierCount(modifier) < __GetNativeModifierCount(m)) {
+    /* replace previous record */
+    res.first->second = __HKUtilsFlatKey(code, modifier, dead);
+    return true;
+  }
+
+  return false;
+}
+
+namespace hk {
+
+/*
+ Cost of a keystroke plan: each keystroke costs keystroke (the key down and key up events),
+ plus modifier per modifier held, plus dead when it enters a dead state.
+ The default weights never prefer a dead key sequence to a single keystroke, and prefer
+ keystrokes with less modifiers.
+ */
+struct KeystrokeWeights {
+  uint32_t keystroke = 8;
+  uint32_t modifier = 1;
+  uint32_t dead = 4;
+};
+
+/*
+ Computes the cheapest keystroke plan of each character.
+
+ Keystrokes and dead states form a graph: a keystroke pressed in a dead state (0 is the
+ 'no dead state' state) either enters an other dead state, or outputs a character. The planner
+ computes the shortest paths from the state 0 (Dijkstra), so ctxt->stats is a tree rooted at
+ the state 0 (following the stats links always terminates), and each character gets its
+ cheapest output keystroke. On equal cost, a dead state is entered by the lowest flat keystroke
+ (see __HKUtilsFlatDead()), whatever the order the transitions were added in, and a character is
+ output by the keystroke added first.
+ */
+class KeystrokePlanner {
+public:
+  explicit KeystrokePlanner(const KeystrokeWeights &weights = KeystrokeWeights()) : _weights(weights) {}
+
+  /* pressing code + modifier in dead state from outputs character */
+  void addOutput(uint16_t from, HKKeycode code, HKModifier modifier, UniChar character);
+  /* pressing code + modifier in dead state from enters dead state to */
+  void addTransition(uint16_t from, HKKeycode code, HKModifier modifier, uint16_t to);
+
+  /* Replaces ctxt->chars and ctxt->stats by the cheapest plans. Unreachable states and characters are dropped. */
+  void compile(HKKeyMapContext *ctxt) const;
+
+private:
+  struct Edge {
+    uint16_t from;
+    uint16_t to; // dead state, or character for outputs
+    uint32_t flat; // keystroke, without dead state
+    uint32_t cost;
+  };
+
+  uint32_t __Cost(HKModifier modifier, bool dead) const {
+    return _weights.keystroke + _weights.modifier * __GetNativeModifierCount(modifier) + (dead ? _weights.dead : 0);
+  }
+
+  KeystrokeWeights _weights;
+  std::vector<Edge> _outputs;
+  std::vector<Edge> _transitions;
+};
+
+} // namespace hk
+
+HK_INLINE
+void __HKUtilsNormalizeEndOfLine(std::unordered_map<uint16_t, uint32_t> &map) {
+  /* Patch to correctly handle new line */
+  HKKeycode crk = 0; HKModifier crm = 0; uint16_t crd = 0;
+  auto cr = map.find('\r');
+  if (cr != map.end())
+    __HKUtilsDeflatKey(cr->second, &crk, &crm, &crd);
+
+  HKKeycode lfk = 0; HKModifier lfm = 0; uint16_t lfd = 0;
+  auto lf = map.find('\n');
+  if (lf != map.end())
+    __HKUtilsDeflatKey(lf->second, &lfk, &lfm, &lfd);
+
+  /* If 'mac return' use modifier or dead key and unix not */
+  if ((cr == map.end() || crm || crd) && (lf != map.end() && !lfm && !lfd)) {
+    map['\r'] = lf->second;
+  } else if ((lf == map.end() || lfm || lfd) && (cr != map.end() && !crm && !crd)) {
+    map['\n'] = cr->second;
+  }
+}
+
+#endif /* __cplusplus */
+
+#endif /* HK_KEYMAP_CONTEXT_H__ */
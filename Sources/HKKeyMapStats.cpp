@@ -0,0 +1,157 @@
+/*
+ *  HKKeyMapStats.cpp
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#include "HKKeyMapStats.h"
+
+#include <mutex>
+
+namespace {
+
+const char *const kKeyMapProbeNames[] = {
+  "fast path",
+  "translate",
+  "keys table",
+  "layout check",
+  "layout copy",
+  "layout load",
+};
+static_assert(sizeof(kKeyMapProbeNames) / sizeof(*kKeyMapProbeNames) == hk::kKeyMapProbeCount, "missing probe name");
+
+#if HK_KEYMAP_STATS
+void _HKStatsAdd(hk::KeyMapStats &stats, const hk::KeyMapStats &other, bool subtract) {
+  for (size_t idx = 0; idx < hk::kKeyMapProbeCount; idx++) {
+    hk::KeyMapProbeStats &probe = stats.probes[idx];
+    const hk::KeyMapProbeStats &value = other.probes[idx];
+    probe.count = subtract ? probe.count - value.count : probe.count + value.count;
+    probe.samples = subtract ? probe.samples - value.samples : probe.samples + value.samples;
+    probe.time = subtract ? probe.time - value.time : probe.time + value.time;
+    for (size_t bucket = 0; bucket < hk::kKeyMapStatsBuckets; bucket++)
+      probe.buckets[bucket] = subtract ? probe.buckets[bucket] - value.buckets[bucket] : probe.buckets[bucket] + value.buckets[bucket];
+  }
+}
+
+struct StatsRegistry {
+  std::mutex lock;
+  hk::stats::Slot *slots = nullptr;
+  /* statistics of the exited threads */
+  hk::KeyMapStats retired = {};
+  /* snapshot at the last reset */
+  hk::KeyMapStats baseline = {};
+};
+
+StatsRegistry &_HKStatsRegistry() {
+  static auto *sRegistry = new StatsRegistry();
+  return *sRegistry;
+}
+
+void _HKStatsAddSlot(hk::KeyMapStats &stats, const hk::stats::Slot &slot) {
+  for (size_t idx = 0; idx < hk::kKeyMapProbeCount; idx++) {
+    hk::KeyMapProbeStats &probe = stats.probes[idx];
+    const hk::stats::Probe &value = slot.probes[idx];
+    probe.count += value.count.load(std::memory_order_relaxed);
+    probe.samples += value.samples.load(std::memory_order_relaxed);
+    probe.time += value.time.load(std::memory_order_relaxed);
+    for (size_t bucket = 0; bucket < hk::kKeyMapStatsBuckets; bucket++)
+      probe.buckets[bucket] += value.buckets[bucket].load(std::memory_order_relaxed);
+  }
+}
+
+/* Must be called with the registry lock */
+hk::KeyMapStats _HKStatsCollect(StatsRegistry &registry) {
+  hk::KeyMapStats stats = registry.retired;
+  for (hk::stats::Slot *slot = registry.slots; slot; slot = slot->next)
+    _HKStatsAddSlot(stats, *slot);
+  return stats;
+}
+#endif
+
+}
+
+// MARK: Thread Slots
+#if HK_KEYMAP_STATS
+thread_local hk::stats::Slot *hk::stats::tSlot = nullptr;
+
+namespace {
+
+/* merges the slot into the retired statistics when the thread exits */
+struct SlotOwner {
+  ~SlotOwner() {
+    if (!slot)
+      return;
+    StatsRegistry &registry = _HKStatsRegistry();
+    std::lock_guard<std::mutex> lock(registry.lock);
+    _HKStatsAddSlot(registry.retired, *slot);
+    for (hk::stats::Slot **iter = &registry.slots; *iter; iter = &(*iter)->next) {
+      if (*iter == slot) {
+        *iter = slot->next;
+        break;
+      }
+    }
+    hk::stats::tSlot = nullptr;
+    delete slot;
+  }
+
+  hk::stats::Slot *slot = nullptr;
+};
+
+thread_local SlotOwner tSlotOwner;
+
+}
+
+hk::stats::Slot *hk::stats::Attach() {
+  Slot *slot = new Slot();
+  StatsRegistry &registry = _HKStatsRegistry();
+  {
+    std::lock_guard<std::mutex> lock(registry.lock);
+    slot->next = registry.slots;
+    registry.slots = slot;
+  }
+  tSlotOwner.slot = slot;
+  tSlot = slot;
+  return slot;
+}
+#endif
+
+// MARK: Snapshot
+uint64_t hk::KeyMapProbeStats::percentile(double p) const {
+  if (!samples)
+    return 0;
+  uint64_t rank = static_cast<uint64_t>(p * samples);
+  uint64_t seen = 0;
+  for (size_t bucket = 0; bucket < kKeyMapStatsBuckets; bucket++) {
+    seen += buckets[bucket];
+    if (seen > rank || seen == samples)
+      return bucket ? 1ULL << bucket : 0;
+  }
+  return 1ULL << (kKeyMapStatsBuckets - 1);
+}
+
+const char *hk::KeyMapProbeName(KeyMapProbe probe) {
+  return probe < kKeyMapProbeCount ? kKeyMapProbeNames[probe] : "unknown";
+}
+
+hk::KeyMapStats hk::KeyMapStatsSnapshot() {
+#if HK_KEYMAP_STATS
+  StatsRegistry &registry = _HKStatsRegistry();
+  std::lock_guard<std::mutex> lock(registry.lock);
+  KeyMapStats stats = _HKStatsCollect(registry);
+  _HKStatsAdd(stats, registry.baseline, true);
+  return stats;
+#else
+  return KeyMapStats();
+#endif
+}
+
+void hk::KeyMapStatsReset() {
+#if HK_KEYMAP_STATS
+  /* slots are only written by their thread: the reset is a baseline substracted from the next snapshots */
+  StatsRegistry &registry = _HKStatsRegistry();
+  std::lock_guard<std::mutex> lock(registry.lock);
+  registry.baseline = _HKStatsCollect(registry);
+#endif
+}
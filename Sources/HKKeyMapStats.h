@@ -0,0 +1,183 @@
+/*
+ *  HKKeyMapStats.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_KEYMAP_STATS_H__)
+#define HK_KEYMAP_STATS_H__ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+
+/*
+ Keymap lookup instrumentation.
+
+ Each thread counts in its own slot (relaxed atomics written by a single thread, so recording
+ never contends), and a snapshot sums the slots of all threads. Probes on the fast path are only
+ counted, other probes also record their duration in a log2 histogram. Reading the clock costs more
+ than a table lookup, so lookups are only timed once every kKeyMapStatsLookupSampling calls.
+
+ The probes are compiled out of release builds (NDEBUG, or HK_KEYMAP_STATS=0 as defined by the
+ framework Release configuration). Define HK_KEYMAP_STATS to 1 to enable them anyway. The snapshot
+ API stays available, and returns empty statistics when the probes are compiled out.
+ */
+#if !defined(HK_KEYMAP_STATS)
+#  if defined(NDEBUG)
+#    define HK_KEYMAP_STATS 0
+#  else
+#    define HK_KEYMAP_STATS 1
+#  endif
+#endif
+
+namespace hk {
+
+enum KeyMapProbe : uint8_t {
+  /* HKCharacterForKeyCodeFunction() resolved using ctxt->map */
+  kKeyMapProbeFastPath,
+  /* HKCharacterForKeyCodeFunction() resolved using ctxt->translate (UCKeyTranslate) */
+  kKeyMapProbeTranslate,
+  /* HKCharacterForKeyCodeFunction() resolved using the keys table */
+  kKeyMapProbeKeysTable,
+  /* keymap update check (layout epoch compare), done before each lookup */
+  kKeyMapProbeLayoutCheck,
+  /* TISCopyCurrentKeyboardLayoutInputSource() */
+  kKeyMapProbeLayoutCopy,
+  /* layout context load (baked, shared or compiled) */
+  kKeyMapProbeLayoutLoad,
+
+  kKeyMapProbeCount,
+};
+
+/* bucket n counts durations in [2^(n-1), 2^n[ ns, the last one also counts longer durations */
+constexpr size_t kKeyMapStatsBuckets = 40;
+/* must be a power of 2 */
+constexpr uint64_t kKeyMapStatsLookupSampling = 64;
+
+struct KeyMapProbeStats {
+  uint64_t count;
+  uint64_t samples; // timed calls, 0 for count only probes
+  uint64_t time; // ns, cumulated duration of the timed calls
+  uint64_t buckets[kKeyMapStatsBuckets];
+
+  /* Upper bound of the bucket containing the requested percentile (0 - 1) */
+  uint64_t percentile(double p) const;
+  uint64_t mean() const { return samples ? time / samples : 0; }
+};
+
+struct KeyMapStats {
+  KeyMapProbeStats probes[kKeyMapProbeCount];
+
+  const KeyMapProbeStats &operator[](KeyMapProbe probe) const { return probes[probe]; }
+};
+
+const char *KeyMapProbeName(KeyMapProbe probe);
+
+/* Statistics recorded by all threads since the last reset */
+KeyMapStats KeyMapStatsSnapshot();
+void KeyMapStatsReset();
+
+#if HK_KEYMAP_STATS
+
+namespace stats {
+
+struct Probe {
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> samples;
+  std::atomic<uint64_t> time;
+  std::atomic<uint64_t> buckets[kKeyMapStatsBuckets];
+};
+
+struct Slot {
+  Probe probes[kKeyMapProbeCount] = {};
+  Slot *next = nullptr;
+};
+
+/* constant initialized, so accessing it does not need a guard */
+extern thread_local Slot *tSlot;
+
+/* Creates the slot of the calling thread (released when the thread exits) */
+Slot *Attach();
+
+inline
+Slot &Current() {
+  Slot *slot = tSlot;
+  return slot ? *slot : *Attach();
+}
+
+/* single writer: no need for an atomic read-modify-write */
+inline
+void Increment(std::atomic<uint64_t> &value, uint64_t delta) {
+  value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+inline
+size_t Bucket(uint64_t ns) {
+  size_t bucket = 0;
+  while (ns && bucket < kKeyMapStatsBuckets - 1) {
+    ns >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+inline
+uint64_t Now() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // namespace stats
+
+inline
+void KeyMapStatsCount(KeyMapProbe probe) {
+  stats::Increment(stats::Current().probes[probe].count, 1);
+}
+
+/* Records a timed call (the call must already be counted) */
+inline
+void KeyMapStatsRecord(KeyMapProbe probe, uint64_t ns) {
+  stats::Probe &slot = stats::Current().probes[probe];
+  stats::Increment(slot.samples, 1);
+  stats::Increment(slot.time, ns);
+  stats::Increment(slot.buckets[stats::Bucket(ns)], 1);
+}
+
+/* Counts a call, and records its duration (the lifetime of the timer) once every sampling calls */
+class KeyMapStatsTimer {
+public:
+  explicit KeyMapStatsTimer(KeyMapProbe probe, uint64_t sampling = 1) : _probe(probe) {
+    std::atomic<uint64_t> &counter = stats::Current().probes[probe].count;
+    uint64_t count = counter.load(std::memory_order_relaxed);
+    stats::Increment(counter, 1);
+    _start = (count & (sampling - 1)) == 0 ? stats::Now() : 0;
+  }
+  ~KeyMapStatsTimer() {
+    if (_start)
+      KeyMapStatsRecord(_probe, stats::Now() - _start);
+  }
+
+  KeyMapStatsTimer(const KeyMapStatsTimer &) = delete;
+  KeyMapStatsTimer &operator=(const KeyMapStatsTimer &) = delete;
+
+private:
+  KeyMapProbe _probe;
+  uint64_t _start;
+};
+
+#  define HK_KEYMAP_STATS_COUNT(probe) hk::KeyMapStatsCount(probe)
+#  define HK_KEYMAP_STATS_TIME(probe) hk::KeyMapStatsTimer __hk_stats_timer(probe)
+#  define HK_KEYMAP_STATS_SAMPLE(probe) hk::KeyMapStatsTimer __hk_stats_timer(probe, hk::kKeyMapStatsLookupSampling)
+#else
+#  define HK_KEYMAP_STATS_COUNT(probe) do {} while (0)
+#  define HK_KEYMAP_STATS_TIME(probe) do {} while (0)
+#  define HK_KEYMAP_STATS_SAMPLE(probe) do {} while (0)
+#endif /* HK_KEYMAP_STATS */
+
+} // namespace hk
+
+#endif /* HK_KEYMAP_STATS_H__ */
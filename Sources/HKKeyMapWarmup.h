@@ -0,0 +1,211 @@
+/*
+ *  HKKeyMapWarmup.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_KEYMAP_WARMUP_H__)
+#define HK_KEYMAP_WARMUP_H__ 1
+
+#include "HKKeyMapContext.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace hk {
+
+/*
+ Compiled contexts shared by all keymaps.
+ A published context is immutable and lives as long as the registry.
+ */
+class KeyMapContextRegistry {
+public:
+  KeyMapContextRegistry() = default;
+  KeyMapContextRegistry(const KeyMapContextRegistry &) = delete;
+  KeyMapContextRegistry &operator=(const KeyMapContextRegistry &) = delete;
+
+  ~KeyMapContextRegistry() {
+    for (auto &iter : _contexts)
+      HKKeyMapContextDealloc(iter.second);
+  }
+
+  /* Returns null if no context was published for key */
+  HKKeyMapContext *lookup(const std::string &key) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto iter = _contexts.find(key);
+    return iter != _contexts.end() ? iter->second : nullptr;
+  }
+
+  /* The registry takes ownership of ctxt. If a context is already published for key, ctxt is released and the published one is returned */
+  HKKeyMapContext *publish(const std::string &key, HKKeyMapContext *ctxt) {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto iter = _contexts.emplace(key, ctxt);
+    if (!iter.second)
+      HKKeyMapContextDealloc(ctxt);
+    return iter.first->second;
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _contexts.size();
+  }
+
+private:
+  mutable std::mutex _lock;
+  std::unordered_map<std::string, HKKeyMapContext *> _contexts;
+};
+
+struct WarmupStats {
+  size_t layouts = 0;
+  size_t compiled = 0;
+  size_t skipped = 0; // already published
+  size_t failed = 0;
+  unsigned workers = 0;
+  uint64_t elapsed = 0; // wall time (ns)
+  uint64_t busy = 0; // sum of compilation times (ns)
+  uint64_t slowest = 0; // longest compilation (ns)
+};
+
+/*
+ Compiles a set of layouts concurrently, and publishes the contexts in a registry as soon
+ as they are ready, so a keymap switching to one of them does not have to compile it.
+
+ Traits:
+ - Layout: the layout source (uchr data, keymap file, …).
+ - static HKKeyMapContext *Compile(const Layout &layout): returns null on failure.
+ - static void Release(Layout &layout): called once the layout is compiled.
+ - static void WorkerWillStart(void): called on each worker thread (used to lower the thread priority).
+
+ A warmup instance runs once. The completion handler is called on the last worker thread.
+ */
+template<class Traits>
+class KeyMapWarmup {
+public:
+  typedef typename Traits::Layout Layout;
+  typedef std::function<void(const WarmupStats &stats)> Completion;
+
+  explicit KeyMapWarmup(KeyMapContextRegistry &registry) : _registry(registry) {}
+  KeyMapWarmup(const KeyMapWarmup &) = delete;
+  KeyMapWarmup &operator=(const KeyMapWarmup &) = delete;
+
+  ~KeyMapWarmup() { wait(); }
+
+  /* workers: 0 means one per core. There is never more workers than layouts. */
+  void start(std::vector<std::pair<std::string, Layout>> layouts, unsigned workers, Completion completion) {
+    _layouts = std::move(layouts);
+    _completion = std::move(completion);
+    if (!workers)
+      workers = std::max(1U, std::thread::hardware_concurrency());
+    workers = static_cast<unsigned>(std::min<size_t>(workers, _layouts.size()));
+
+    _stats.layouts = _layouts.size();
+    _stats.workers = workers;
+    _start = std::chrono::steady_clock::now();
+    _running.store(workers, std::memory_order_relaxed);
+    if (!workers) {
+      __complete();
+      return;
+    }
+    _threads.reserve(workers);
+    for (unsigned idx = 0; idx < workers; idx++)
+      _threads.emplace_back([this] { __work(); });
+  }
+
+  /* Waits for all workers. Must not be called from the completion handler */
+  void wait() {
+    {
+      std::unique_lock<std::mutex> lock(_lock);
+      _condition.wait(lock, [this] { return _complete; });
+    }
+    for (std::thread &thread : _threads) {
+      if (thread.joinable())
+        thread.join();
+    }
+  }
+
+  bool isComplete() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _complete;
+  }
+
+  WarmupStats stats() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _stats;
+  }
+
+private:
+  void __work() {
+    Traits::WorkerWillStart();
+    size_t idx;
+    while ((idx = _next.fetch_add(1, std::memory_order_relaxed)) < _layouts.size()) {
+      auto &layout = _layouts[idx];
+      if (_registry.lookup(layout.first)) {
+        Traits::Release(layout.second);
+        std::lock_guard<std::mutex> lock(_lock);
+        _stats.skipped++;
+        continue;
+      }
+      auto start = std::chrono::steady_clock::now();
+      HKKeyMapContext *ctxt = Traits::Compile(layout.second);
+      uint64_t duration = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+      Traits::Release(layout.second);
+      if (ctxt)
+        _registry.publish(layout.first, ctxt);
+
+      std::lock_guard<std::mutex> lock(_lock);
+      if (ctxt) {
+        _stats.compiled++;
+        _stats.busy += duration;
+        _stats.slowest = std::max(_stats.slowest, duration);
+      } else {
+        _stats.failed++;
+      }
+    }
+    if (_running.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      __complete();
+  }
+
+  void __complete() {
+    WarmupStats stats;
+    {
+      std::lock_guard<std::mutex> lock(_lock);
+      _stats.elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count());
+      stats = _stats;
+    }
+    if (_completion)
+      _completion(stats);
+    {
+      std::lock_guard<std::mutex> lock(_lock);
+      _complete = true;
+    }
+    _condition.notify_all();
+  }
+
+  KeyMapContextRegistry &_registry;
+  std::vector<std::pair<std::string, Layout>> _layouts;
+  Completion _completion;
+  std::vector<std::thread> _threads;
+  std::atomic<size_t> _next{0};
+  std::atomic<unsigned> _running{0};
+  std::chrono::steady_clock::time_point _start;
+
+  mutable std::mutex _lock;
+  std::condition_variable _condition;
+  WarmupStats _stats;
+  bool _complete = false;
+};
+
+} // namespace hk
+
+#endif /* HK_KEYMAP_WARMUP_H__ */
@@ -0,0 +1,263 @@
+/*
+ *  HKKeyMapXKB.cpp
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#include "HKKeyMapXKB.h"
+#include "HKKeyMapBaked.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <xkbcommon/xkbcommon.h>
+#include <xkbcommon/xkbcommon-compose.h>
+
+// MARK: Keycodes
+/* macOS virtual keycode -> evdev keycode (0 means no layout key at this position) */
+static constexpr uint8_t kHKXKBEvdevKeycodes[128] = {
+  /* 0x00 */ 30 /* A */, 31 /* S */, 32 /* D */, 33 /* F */, 35 /* H */, 34 /* G */, 44 /* Z */, 45 /* X */,
+  /* 0x08 */ 46 /* C */, 47 /* V */, 86 /* ISO Section */, 48 /* B */, 16 /* Q */, 17 /* W */, 18 /* E */, 19 /* R */,
+  /* 0x10 */ 21 /* Y */, 20 /* T */, 2 /* 1 */, 3 /* 2 */, 4 /* 3 */, 5 /* 4 */, 7 /* 6 */, 6 /* 5 */,
+  /* 0x18 */ 13 /* = */, 10 /* 9 */, 8 /* 7 */, 12 /* - */, 9 /* 8 */, 11 /* 0 */, 27 /* ] */, 24 /* O */,
+  /* 0x20 */ 22 /* U */, 26 /* [ */, 23 /* I */, 25 /* P */, 28 /* Return */, 38 /* L */, 36 /* J */, 40 /* ' */,
+  /* 0x28 */ 37 /* K */, 39 /* ; */, 43 /* \ */, 51 /* , */, 53 /* / */, 49 /* N */, 50 /* M */, 52 /* . */,
+  /* 0x30 */ 15 /* Tab */, 57 /* Space */, 41 /* ` */, 0, 0, 0, 0, 0,
+  /* 0x38 */ 0, 0, 0, 0, 0, 0, 0, 0,
+  /* 0x40 */ 0, 83 /* Keypad . */, 0, 55 /* Keypad * */, 0, 78 /* Keypad + */, 0, 0,
+  /* 0x48 */ 0, 0, 0, 98 /* Keypad / */, 96 /* Keypad Enter */, 0, 74 /* Keypad - */, 0,
+  /* 0x50 */ 0, 117 /* Keypad = */, 82 /* Keypad 0 */, 79 /* Keypad 1 */, 80 /* Keypad 2 */, 81 /* Keypad 3 */, 75 /* Keypad 4 */, 76 /* Keypad 5 */,
+  /* 0x58 */ 77 /* Keypad 6 */, 71 /* Keypad 7 */, 0, 72 /* Keypad 8 */, 73 /* Keypad 9 */, 124 /* JIS Yen */, 89 /* JIS Underscore */, 121 /* JIS Keypad , */,
+};
+
+/* xkb keycodes are evdev keycodes + 8 */
+HK_INLINE
+xkb_keycode_t __HKXKBKeycode(HKKeycode keycode) {
+  return keycode < 128 && kHKXKBEvdevKeycodes[keycode] ? kHKXKBEvdevKeycodes[keycode] + 8 : 0;
+}
+
+HK_INLINE
+bool __HKXKBKeysymIsDead(xkb_keysym_t sym) {
+  /* XKB_KEY_dead_grave … XKB_KEY_dead_longsolidusoverlay */
+  return sym >= 0xfe50 && sym <= 0xfe93;
+}
+
+HK_INLINE
+UniChar __HKXKBKeysymToUnichar(xkb_keysym_t sym) {
+  uint32_t unicode = xkb_keysym_to_utf32(sym);
+  /* characters outside the BMP are not supported by the keymap context */
+  return unicode && unicode < 0xfffe ? static_cast<UniChar>(unicode) : hk::kKeyMapNilCharacter;
+}
+
+// MARK: Modifiers
+/* Ordered by number of modifiers, so on equal cost, the planner keeps the simplest keystroke */
+static constexpr HKModifier kHKXKBModifiers[] = {
+  0,
+  kCGEventFlagMaskShift,
+  kCGEventFlagMaskAlphaShift,
+  kCGEventFlagMaskAlternate,
+  kCGEventFlagMaskShift | kCGEventFlagMaskAlternate,
+  kCGEventFlagMaskShift | kCGEventFlagMaskAlphaShift,
+  kCGEventFlagMaskAlphaShift | kCGEventFlagMaskAlternate,
+  kCGEventFlagMaskShift | kCGEventFlagMaskAlphaShift | kCGEventFlagMaskAlternate,
+};
+
+HK_INLINE
+xkb_mod_mask_t __HKXKBModMask(struct xkb_keymap *keymap, const char *name) {
+  xkb_mod_index_t idx = xkb_keymap_mod_get_index(keymap, name);
+  return idx != XKB_MOD_INVALID ? 1U << idx : 0;
+}
+
+// MARK: Builder
+namespace {
+
+struct XKBKeystroke {
+  HKKeycode keycode;
+  HKModifier modifier;
+  xkb_keysym_t sym;
+};
+
+}
+
+static
+UniChar _HKXKBCompose(struct xkb_compose_state *state, xkb_keysym_t dead, xkb_keysym_t sym) {
+  xkb_compose_state_reset(state);
+  xkb_compose_state_feed(state, dead);
+  xkb_compose_state_feed(state, sym);
+  if (xkb_compose_state_get_status(state) != XKB_COMPOSE_COMPOSED)
+    return hk::kKeyMapNilCharacter;
+  xkb_keysym_t composed = xkb_compose_state_get_one_sym(state);
+  if (composed != XKB_KEY_NoSymbol)
+    return __HKXKBKeysymToUnichar(composed);
+
+  /* multi characters output, or output without keysym. Only single BMP character are supported */
+  char utf8[8];
+  int length = xkb_compose_state_get_utf8(state, utf8, sizeof(utf8));
+  const unsigned char *c = reinterpret_cast<const unsigned char *>(utf8);
+  if (length == 1 && c[0] < 0x80)
+    return c[0];
+  if (length == 2 && (c[0] & 0xe0) == 0xc0)
+    return static_cast<UniChar>(((c[0] & 0x1f) << 6) | (c[1] & 0x3f));
+  if (length == 3 && (c[0] & 0xf0) == 0xe0)
+    return static_cast<UniChar>(((c[0] & 0x0f) << 12) | ((c[1] & 0x3f) << 6) | (c[2] & 0x3f));
+  return hk::kKeyMapNilCharacter;
+}
+
+HKKeyMapContext *HKKeyMapContextCreateWithXKBKeymap(struct xkb_keymap *keymap, struct xkb_compose_table *compose) {
+  struct xkb_state *state = xkb_state_new(keymap);
+  if (!state)
+    return NULL;
+
+  xkb_mod_mask_t shift = __HKXKBModMask(keymap, XKB_MOD_NAME_SHIFT);
+  xkb_mod_mask_t caps = __HKXKBModMask(keymap, XKB_MOD_NAME_CAPS);
+  /* Level 3 is bound to Mod5 by the standard keymaps */
+  xkb_mod_mask_t option = __HKXKBModMask(keymap, "Mod5");
+
+  HKKeyMapContext *ctxt = new HKKeyMapContext();
+  hk::KeystrokePlanner planner;
+
+  std::vector<XKBKeystroke> keystrokes;
+  /* dead keysym -> dead state, and dead state - 1 -> dead keysym */
+  std::unordered_map<xkb_keysym_t, uint16_t> deads;
+  std::vector<xkb_keysym_t> deadsyms;
+  for (HKModifier modifier : kHKXKBModifiers) {
+    xkb_mod_mask_t mask = 0;
+    if (modifier & kCGEventFlagMaskShift) mask |= shift;
+    if (modifier & kCGEventFlagMaskAlphaShift) mask |= caps;
+    if (modifier & kCGEventFlagMaskAlternate) mask |= option;
+    if (modifier && !mask)
+      continue;
+    xkb_state_update_mask(state, mask, 0, 0, 0, 0, 0);
+
+    for (HKKeycode keycode = 0; keycode < 128; keycode++) {
+      xkb_keycode_t code = __HKXKBKeycode(keycode);
+      if (!code)
+        continue;
+      xkb_keysym_t sym = xkb_state_key_get_one_sym(state, code);
+      if (sym == XKB_KEY_NoSymbol)
+        continue;
+
+      if (__HKXKBKeysymIsDead(sym)) {
+        /* dead states are numbered from 1, as 0 means 'no dead state' */
+        auto dead = deads.try_emplace(sym, static_cast<uint16_t>(deads.size() + 1));
+        if (dead.second)
+          deadsyms.push_back(sym);
+        planner.addTransition(0, keycode, modifier, dead.first->second);
+        continue;
+      }
+
+      UniChar unicode = __HKXKBKeysymToUnichar(sym);
+      if (unicode == hk::kKeyMapNilCharacter)
+        continue;
+      keystrokes.push_back({ keycode, modifier, sym });
+      ctxt->keys.try_emplace(__HKUtilsFlatKey(keycode, modifier, 0), unicode);
+      planner.addOutput(0, keycode, modifier, unicode);
+      if (!modifier)
+        ctxt->map[keycode] = unicode;
+    }
+  }
+  xkb_state_unref(state);
+
+  /* handle dead states (in state order, so equal cost plans do not depend on the hash table order) */
+  struct xkb_compose_state *cstate = compose && !deads.empty() ? xkb_compose_state_new(compose, XKB_COMPOSE_STATE_NO_FLAGS) : NULL;
+  if (cstate) {
+    for (uint16_t dead = 1; dead <= deadsyms.size(); dead++) {
+      for (const XKBKeystroke &keystroke : keystrokes) {
+        UniChar unicode = _HKXKBCompose(cstate, deadsyms[dead - 1], keystroke.sym);
+        if (unicode != hk::kKeyMapNilCharacter)
+          planner.addOutput(dead, keystroke.keycode, keystroke.modifier, unicode);
+      }
+    }
+  }
+  planner.compile(ctxt);
+
+  if (cstate) {
+    for (uint16_t dead = 1; dead <= deadsyms.size(); dead++) {
+      /* like UCKeyTranslate, a dead key alone outputs the character it produces with space */
+      const auto stroke = ctxt->stats.find(dead);
+      /* not reachable from the initial state */
+      if (stroke == ctxt->stats.end())
+        continue;
+      HKKeycode k = 0;
+      HKModifier m = 0;
+      __HKUtilsDeflatKey(stroke->second, &k, &m, NULL);
+      UniChar spacing = _HKXKBCompose(cstate, deadsyms[dead - 1], 0x0020 /* XKB_KEY_space */);
+      if (spacing != hk::kKeyMapNilCharacter)
+        ctxt->keys.try_emplace(__HKUtilsFlatKey(k, m, 0), spacing);
+    }
+    xkb_compose_state_unref(cstate);
+  }
+
+  __HKUtilsNormalizeEndOfLine(ctxt->chars);
+
+  return ctxt;
+}
+
+static
+const char *_HKXKBLocale(const char *locale) {
+  if (!locale) {
+    locale = getenv("LC_ALL");
+    if (!locale || !*locale) locale = getenv("LC_CTYPE");
+    if (!locale || !*locale) locale = getenv("LANG");
+    if (!locale || !*locale) locale = "C";
+  }
+  return locale;
+}
+
+HKKeyMapContext *HKKeyMapContextCreateWithXKBString(const char *text, size_t length, const char *locale) {
+  HKKeyMapContext *ctxt = NULL;
+  struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+  struct xkb_keymap *keymap = context ? xkb_keymap_new_from_buffer(context, text, length, XKB_KEYMAP_FORMAT_TEXT_V1, XKB_KEYMAP_COMPILE_NO_FLAGS) : NULL;
+  if (keymap) {
+    struct xkb_compose_table *compose = xkb_compose_table_new_from_locale(context, _HKXKBLocale(locale), XKB_COMPOSE_COMPILE_NO_FLAGS);
+    ctxt = HKKeyMapContextCreateWithXKBKeymap(keymap, compose);
+    if (compose)
+      xkb_compose_table_unref(compose);
+    xkb_keymap_unref(keymap);
+  }
+  if (context)
+    xkb_context_unref(context);
+  return ctxt;
+}
+
+HKKeyMapContext *HKKeyMapContextCreateWithXKBFile(const char *path, const char *locale) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
+
+  std::string text;
+  char buffer[4096];
+  size_t length;
+  while ((length = fread(buffer, 1, sizeof(buffer), f)) > 0)
+    text.append(buffer, length);
+  bool ok = !ferror(f);
+  fclose(f);
+  if (!ok)
+    return NULL;
+
+  HKKeyMapContext *ctxt = HKKeyMapContextGetBakedXKB(text.data(), text.size(), locale);
+  return ctxt ? ctxt : HKKeyMapContextCreateWithXKBString(text.data(), text.size(), locale);
+}
+
+/* keymap: hash of the keymap text, so it is hashed only once for both lookups */
+static
+uint64_t _HKXKBLayoutHash(uint64_t keymap, const char *locale) {
+  return HKKeyMapLayoutHash(&keymap, sizeof(keymap), HKKeyMapLayoutHash(locale, strlen(locale), 0));
+}
+
+HKKeyMapContext *HKKeyMapContextGetBakedXKB(const char *keymap, size_t length, const char *locale) {
+  uint64_t hash = HKKeyMapLayoutHash(keymap, length, 0);
+  /* keymaps without dead keys are baked once for any locale */
+  HKKeyMapContext *ctxt = HKKeyMapContextGetBaked(_HKXKBLayoutHash(hash, ""));
+  return ctxt ? ctxt : HKKeyMapContextGetBaked(_HKXKBLayoutHash(hash, _HKXKBLocale(locale)));
+}
+
+uint64_t HKKeyMapXKBLayoutHash(const char *keymap, size_t length, const char *locale) {
+  return _HKXKBLayoutHash(HKKeyMapLayoutHash(keymap, length, 0), _HKXKBLocale(locale));
+}
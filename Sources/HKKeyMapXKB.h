@@ -0,0 +1,66 @@
+/*
+ *  HKKeyMapXKB.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_KEYMAP_XKB_H__)
+#define HK_KEYMAP_XKB_H__ 1
+
+#include "HKKeyMapContext.h"
+
+/*
+ XKB keymap backend.
+
+ Compiles a XKB keymap (using libxkbcommon, no display server required) into a keymap context,
+ so the lookup functions of HKKeyMapContext.h can be used on platforms without TIS/uchr.
+
+ - Keycodes are macOS virtual keycodes (ANSI/ISO/JIS positions are translated to evdev keycodes).
+ - Option is mapped on the third level modifier (AltGr), and Caps Lock on the Lock modifier.
+ - Dead keys are resolved using the compose table of the locale (one dead key level only).
+
+ Only layout keys are compiled. Special keys (function keys, arrows, …) are layout independent
+ and are handled by HKSpecialKeys.h.
+ */
+
+struct xkb_keymap;
+struct xkb_compose_table;
+
+/* compose may be NULL (dead keys are then ignored) */
+HK_PRIVATE
+HKKeyMapContext *HKKeyMapContextCreateWithXKBKeymap(struct xkb_keymap *keymap, struct xkb_compose_table *compose);
+
+/*!
+ @function
+ @abstract   Compiles a keymap string (as produced by xkbcomp or xkb_keymap_get_as_string()).
+ @param      locale The locale used to load the compose table. If NULL, uses the environment locale.
+ @result     Returns NULL if the keymap cannot be loaded.
+ */
+HK_PRIVATE
+HKKeyMapContext *HKKeyMapContextCreateWithXKBString(const char *keymap, size_t length, const char *locale);
+
+/*!
+ @function
+ @abstract   Loads a keymap file. If the keymap was baked at build time for this locale (see HKKeyMapBaked.h),
+ returns the static context, else compiles it.
+ */
+HK_PRIVATE
+HKKeyMapContext *HKKeyMapContextCreateWithXKBFile(const char *path, const char *locale);
+
+/*!
+ @function
+ @result     Returns the static context of the keymap baked for any locale, or for locale, or NULL.
+ */
+HK_PRIVATE
+HKKeyMapContext *HKKeyMapContextGetBakedXKB(const char *keymap, size_t length, const char *locale);
+
+/*
+ Identifies a keymap compiled with the compose table of locale (NULL for the environment locale).
+ An empty locale identifies a keymap without dead keys, which does not depend on the compose table.
+ */
+HK_PRIVATE
+uint64_t HKKeyMapXKBLayoutHash(const char *keymap, size_t length, const char *locale);
+
+#endif /* HK_KEYMAP_XKB_H__ */
@@ -7,16 +7,29 @@
 
 #import <HotKeyToolKit/HKBase.h>
 
-typedef struct __HKKeyMapContext HKKeyMapContext;
+#include "HKKeyMapContext.h"
 
 HK_PRIVATE
 HKKeyMapContext *HKKeyMapContextCreateWithUchrData(CFDataRef uchr);
 
+/* Incremented each time the selected keyboard input source changes */
 HK_PRIVATE
-UniChar HKCharacterForKeyCodeFunction(HKKeyMapContext *ctxt, HKKeycode keycode, HKModifier modifier);
+uint32_t HKKeyMapGetLayoutEpoch(void);
 
+/*
+ Called when the current keymap layout changes, with the contexts of the previous and current layouts.
+ Contexts are only valid during the call.
+ */
+typedef void (*HKKeyMapLayoutObserver)(HKKeyMapContext *previous, HKKeyMapContext *current);
+
+/* Sets the observer (NULL removes it), and updates the current keymap each time the selected input source changes. Main thread only. */
 HK_PRIVATE
-NSUInteger HKKeycodesForCharacterFunction(HKKeyMapContext *ctxt, UniChar character, HKKeycode *keys, HKModifier *modifiers, NSUInteger maxsize);
+void HKKeyMapSetLayoutObserver(HKKeyMapLayoutObserver observer);
+
+#if defined(__OBJC__)
+@class NSString;
 
+/* Cached version of +[HKKeyMap stringRepresentationForCharacter:modifiers:] */
 HK_PRIVATE
-void HKKeyMapContextDealloc(HKKeyMapContext *ctxt);
+NSString *HKKeyMapGetShortcutString(UniChar character, HKModifier modifiers);
+#endif
@@ -10,60 +10,10 @@
 
 #include <Carbon/Carbon.h>
 #include <unordered_map>
+#include <vector>
 
 #import "HKKeyMap.h"
 
-#pragma mark Flat and deflate
-/* Flat format:
------------------------------------------------------------------
-| dead state (14 bits) | modifiers (10 bits) | keycode (8 bits) |
------------------------------------------------------------------
-Note: keycode = 0xff => keycode is 0.
-*/
-
-HK_INLINE
-uint32_t __HKUtilsFlatKey(HKKeycode code, HKModifier modifier, UInt32 dead) {
-  spx_assert(code < 128, "invalid value");
-  /* We change keycode 0 to 0xff, so the return value is never 0, as flat == 0 mean invalid */
-  /* modifier: modifier use only 16 high bits and 0x3ff00 is 0x3ff << 8 */
-  return ((code ? : 0xff) & 0xff) | ((modifier >> 8) & 0x3ff00) | (dead & 0x3fff) << 18;
-}
-HK_INLINE
-uint32_t __HKUtilsFlatDead(uint32_t flat, UInt32 dead) {
-  return (flat & 0x3ffff) | ((dead & 0x3fff) << 18);
-}
-HK_INLINE
-void __HKUtilsDeflatKey(uint32_t flat, HKKeycode *code, HKModifier *modifier, uint16_t *dead) {
-  if (code) {
-    *code = flat & 0xff;
-    if (*code == 0xff) *code = 0;
-  }
-  if (modifier) *modifier = (HKModifier)(flat & 0x3ff00) << 8;
-  if (dead) *dead = (flat >> 18) & 0x3fff;
-}
-
-
-HK_INLINE
-void __HKUtilsNormalizeEndOfLine(std::unordered_map<uint16_t, uint32_t> &map) {
-  /* Patch to correctly handle new line */
-  HKKeycode mack = 0; HKModifier macm = 0; uint16_t macd = 0;
-  auto mac = map.find('\r');
-  if (mac != map.end())
-    __HKUtilsDeflatKey(mac->second, &mack, &macm, &macd);
-
-  HKKeycode unixk = 0; HKModifier unixm = 0; uint16_t unixd = 0;
-  auto unix = map.find('\n');
-  if (unix != map.end())
-    __HKUtilsDeflatKey(unix->second, &unixk, &unixm, &unixd);
-
-  /* If 'mac return' use modifier or dead key and unix not */
-  if ((mac == map.end() || macm || macd) && (unix != map.end() && !unixm && !unixd)) {
-    map['\r'] = unix->second;
-  } else if ((unix == map.end() || unixm || unixd) && (mac != map.end() && !macm && !macd)) {
-    map['\n'] = mac->second;
-  }
-}
-
 #pragma mark Modifiers
 enum {
   kCommandKey = 1 << 0,
@@ -90,17 +40,6 @@ UInt32 __GetModifierCount(NSUInteger idx) {
   return count;
 }
 
-HK_INLINE
-UInt32 __GetNativeModifierCount(HKModifier idx) {
-  UInt32 count = 0;
-  if (idx & kCGEventFlagMaskShift) count++;
-  if (idx & kCGEventFlagMaskControl) count++;
-  if (idx & kCGEventFlagMaskCommand) count++;
-  if (idx & kCGEventFlagMaskAlternate) count++;
-  if (idx & kCGEventFlagMaskAlphaShift) count++;
-  return count;
-}
-
 static
 void __HKUtilsConvertModifiers(uint32_t *mods, NSInteger count) {
   while (count-- > 0) {
@@ -121,14 +60,6 @@ void __HKUtilsConvertModifiers(uint32_t *mods, NSInteger count) {
 
 #pragma mark -
 #pragma mark UCHR
-typedef struct __HKKeyMapContext {
-  CFDataRef uchr;
-  UniChar map[128];
-  std::unordered_map<uint16_t, uint32_t> chars;
-  std::unordered_map<uint16_t, uint32_t> stats;
-  const UCKeyboardLayout *layout;
-} HKKeyMapContext;
-
 static
 UniChar UchrCharacterForKeyCodeAndKeyboard(const UCKeyboardLayout *layout, HKKeycode keycode, HKModifier modifiers) {
   UniChar string[3];
@@ -154,55 +85,20 @@ UniChar UchrCharacterForKeyCodeAndKeyboard(const UCKeyboardLayout *layout, HKKey
   return kHKNilUnichar;
 }
 
-UniChar HKCharacterForKeyCodeFunction(HKKeyMapContext *ctxt, HKKeycode keycode, HKModifier modifiers) {
-  // fast path (does not works for dead key)
-  if (!modifiers && keycode < 128 && ctxt->map[keycode] != kHKNilUnichar)
-    return ctxt->map[keycode];
-  return UchrCharacterForKeyCodeAndKeyboard(ctxt->layout, keycode, modifiers);
+HK_INLINE
+const UCKeyboardLayout *__HKUchrContextGetLayout(const HKKeyMapContext *ctxt) {
+  return reinterpret_cast<const UCKeyboardLayout *>(CFDataGetBytePtr(static_cast<CFDataRef>(ctxt->info)));
 }
 
-NSUInteger HKKeycodesForCharacterFunction(HKKeyMapContext *ctxt, UniChar character, HKKeycode *keys, HKModifier *modifiers, NSUInteger maxsize) {
-  NSUInteger count = 0;
-  NSUInteger limit = 10;
-  HKKeycode ikeys[10];
-  HKModifier imodifiers[10];
-
-  uint16_t d = 0;
-  HKKeycode k = 0;
-  HKModifier m = 0;
-  auto iter = ctxt->chars.find(character);
-  if (iter == ctxt->chars.end())
-    return 0;
-
-  uint32_t flat = iter->second;
-  while (flat && count < limit) {
-    __HKUtilsDeflatKey(flat, &k, &m, &d);
-    ikeys[count] = k;
-    imodifiers[count] = m;
-    count++;
-    if (d) {
-      auto siter = ctxt->stats.find(d);
-      if (siter != ctxt->stats.end())
-        flat = siter->second;
-      else
-        flat = 0;
-    } else {
-      flat = 0;
-    }
-  }
-  NSUInteger idx = 0;
-  while (idx < count && idx < maxsize) {
-    keys[idx] = ikeys[count - idx - 1];
-    modifiers[idx] = imodifiers[count - idx - 1];
-    idx++;
-  }
-  return count;
+static
+UniChar _HKUchrContextTranslate(const HKKeyMapContext *ctxt, HKKeycode keycode, HKModifier modifiers) {
+  return UchrCharacterForKeyCodeAndKeyboard(__HKUchrContextGetLayout(ctxt), keycode, modifiers);
 }
 
-void HKKeyMapContextDealloc(HKKeyMapContext *ctxt) {
-  if (ctxt->uchr)
-    CFRelease(ctxt->uchr);
-  delete ctxt;
+static
+void _HKUchrContextDispose(HKKeyMapContext *ctxt) {
+  if (ctxt->info)
+    CFRelease(static_cast<CFDataRef>(ctxt->info));
 }
 
 HK_INLINE
@@ -238,37 +134,17 @@ bool __HKUCHRKeyCharIsSequence(UCKeyCharSeq output) {
   return (output & (1 << 15)) == (1 << 15);
 }
 
-HK_INLINE
-bool __HKMapInsertIfBetter(std::unordered_map<uint16_t, uint32_t> &table, uint16_t key, HKKeycode code, HKModifier modifier, UInt32 dead) {
-  auto res = table.try_emplace(key, __HKUtilsFlatKey(code, modifier, dead));
-  if (res.second) // if this was a new entry -> we are done
-    return true;
-
-  /* retreive previous modifier */
-  HKModifier m = 0;
-  __HKUtilsDeflatKey(res.first->second, NULL, &m, NULL);
-  /* if new modifier uses less key than the previous one */
-  if (__GetNativeModifierCount(modifier) < __GetNativeModifierCount(m)) {
-    /* replace previous record */
-    res.first->second = __HKUtilsFlatKey(code, modifier, dead);
-    return true;
-  }
-
-  return false;
-}
-
 HKKeyMapContext *HKKeyMapContextCreateWithUchrData(CFDataRef uchr) {
   HKKeyMapContext *ctxt = new HKKeyMapContext();
-  ctxt->uchr = uchr;
-  CFRetain(uchr);
+  ctxt->info = CFRetain(uchr);
+  ctxt->translate = _HKUchrContextTranslate;
+  ctxt->dispose = _HKUchrContextDispose;
 
-  ctxt->layout = reinterpret_cast<const UCKeyboardLayout *>(CFDataGetBytePtr(uchr));
-  /* set nil unichar in all blocks */
-  memset(ctxt->map, 0xff, sizeof(ctxt->map));
+  const UCKeyboardLayout *layout = __HKUchrContextGetLayout(ctxt);
 
   // Load table and reverse table
-  const uint8_t *data = reinterpret_cast<const uint8_t *>(ctxt->layout);
-  const UCKeyboardTypeHeader *header = __UCKeyboardHeaderForCurrentKeyboard(ctxt->layout);
+  const uint8_t *data = reinterpret_cast<const uint8_t *>(layout);
+  const UCKeyboardTypeHeader *header = __UCKeyboardHeaderForCurrentKeyboard(layout);
   const UCKeyToCharTableIndex *tables = reinterpret_cast<const UCKeyToCharTableIndex *>(data + header->keyToCharTableIndexOffset);
   const UCKeyModifiersToTableNum *modifiers = reinterpret_cast<const UCKeyModifiersToTableNum *>(data + header->keyModifiersToTableNumOffset);
   /* optionals */
@@ -297,8 +173,10 @@ HKKeyMapContext *HKKeyMapContextCreateWithUchrData(CFDataRef uchr) {
   }
   __HKUtilsConvertModifiers(tmod, tables->keyToCharTableCount);
 
-  /* Deadr is a temporary map that map deadkey record index to keycode */
-  std::unordered_map<uint16_t, uint32_t> deadr = std::unordered_map<uint16_t, uint32_t>();
+  /* keystrokes and dead states graph, the reverse tables are the cheapest paths in this graph */
+  hk::KeystrokePlanner planner;
+  /* Deadr is a temporary map that map deadkey record index to the keystrokes producing it */
+  std::unordered_map<uint16_t, std::vector<uint32_t>> deadr;
 
   /* Foreach key in each table */
   for (NSUInteger idx = 0; idx < tables->keyToCharTableCount; idx++) {
@@ -316,8 +194,8 @@ HKKeyMapContext *HKKeyMapContextCreateWithUchrData(CFDataRef uchr) {
 //        }
       } else if (__HKUCHROutputIsStateRecord(output[key])) { // if "State Record", save it into deadr table
         uint16_t keyState = output[key] & 0x3fff;
-        // deadr contains as key the state record, and as value, the keystroke we have to use to "produce" this state.
-        __HKMapInsertIfBetter(deadr, keyState, (HKKeycode)key, (HKModifier)tmod[idx], 0);
+        // deadr contains as key the state record, and as value, the keystrokes we can use to "produce" this state.
+        deadr[keyState].push_back(__HKUtilsFlatKey((HKKeycode)key, (HKModifier)tmod[idx], 0));
 
         /* for table without modifiers only, save the record into the fast map */
         // FIXME: broken: should set it to first key of the sequence, not on terminator key
@@ -338,7 +216,7 @@ HKKeyMapContext *HKKeyMapContextCreateWithUchrData(CFDataRef uchr) {
         }
 #endif
       } else {
-        __HKMapInsertIfBetter(ctxt->chars, output[key], (HKKeycode)key, (HKModifier)tmod[idx], 0);
+        planner.addOutput(0, (HKKeycode)key, (HKModifier)tmod[idx], output[key]);
         // Save it into simple mapping table
         if (tmod[idx] == 0 && key < 128)
           ctxt->map[key] = output[key];
@@ -353,56 +231,51 @@ HKKeyMapContext *HKKeyMapContextCreateWithUchrData(CFDataRef uchr) {
       const auto iter = deadr.find(idx);
       if (iter == deadr.end()) {
         spx_log("Unreachable block: %u", idx);
-      } else {
-        uint32_t code = iter->second;
-        const UCKeyStateRecord *record = reinterpret_cast<const UCKeyStateRecord *>(data + records->keyStateRecordOffsets[idx]);
+        continue;
+      }
+      const UCKeyStateRecord *record = reinterpret_cast<const UCKeyStateRecord *>(data + records->keyStateRecordOffsets[idx]);
+      if (record->stateEntryCount && kUCKeyStateEntryRangeFormat == record->stateEntryFormat)
+        spx_log("Range entry not implemented");
+      /* every keystroke producing the record is an edge of the graph: the planner chooses the cheapest one */
+      for (uint32_t code : iter->second) {
+        HKKeycode k = 0;
+        HKModifier m = 0;
+        __HKUtilsDeflatKey(code, &k, &m, NULL);
         if (record->stateZeroCharData != 0 && record->stateZeroNextState == 0) {
           UCKeyCharSeq unicode = record->stateZeroCharData;
           if (__HKUCHRKeyCharIsSequence(unicode)) {
             // Warning: sequence
           } else {
-            /* Get keycode to access record idx */
-            ctxt->chars.try_emplace(unicode, code);
+            planner.addOutput(0, k, m, unicode);
 
             /* Update fast table map */
-            uint16_t d;
-            HKKeycode k = 0;
-            HKModifier m = 0;
-            __HKUtilsDeflatKey(code, &k, &m, &d);
             if (0 == m && kHKNilUnichar == ctxt->map[k]) {
               ctxt->map[k] = unicode;
             }
           }
         } else if ((record->stateZeroCharData == 0 || record->stateZeroCharData >= 0xFFFE) && record->stateZeroNextState != 0) {
           // No output and next state not null
-          // Map dead state to keycode
-          ctxt->stats.try_emplace(record->stateZeroNextState, code);
+          // Enter dead state
+          planner.addTransition(0, k, m, record->stateZeroNextState);
         }
         // Browse all record output
-        if (record->stateEntryCount) {
-          NSUInteger entry = 0;
-          if (kUCKeyStateEntryTerminalFormat == record->stateEntryFormat) {
-            const UCKeyStateEntryTerminal *term = reinterpret_cast<const UCKeyStateEntryTerminal *>(record->stateEntryData);
-            while (entry < record->stateEntryCount) {
-              UCKeyCharSeq unicode = term->charData;
-              // Should resolve sequence
-              if (__HKUCHRKeyCharIsSequence(unicode)) {
-                //spx_debug("WARNING: Sequence: %u", unicode & 0x3fff);
-              } else {
-                // Get previous keycode and append dead key state
-                code = __HKUtilsFlatDead(code, term->curState);
-                ctxt->chars.try_emplace(unicode, code);
-              }
-              term++;
-              entry++;
+        if (record->stateEntryCount && kUCKeyStateEntryTerminalFormat == record->stateEntryFormat) {
+          const UCKeyStateEntryTerminal *term = reinterpret_cast<const UCKeyStateEntryTerminal *>(record->stateEntryData);
+          for (NSUInteger entry = 0; entry < record->stateEntryCount; entry++, term++) {
+            UCKeyCharSeq unicode = term->charData;
+            // Should resolve sequence
+            if (__HKUCHRKeyCharIsSequence(unicode)) {
+              //spx_debug("WARNING: Sequence: %u", unicode & 0x3fff);
+            } else {
+              // keystroke pressed in the dead state
+              planner.addOutput(term->curState, k, m, unicode);
             }
-          } else if (kUCKeyStateEntryRangeFormat == record->stateEntryFormat) {
-            spx_log("Range entry not implemented");
           }
         } // reverse
       }
     }
   }
+  planner.compile(ctxt);
 
   __HKUtilsNormalizeEndOfLine(ctxt->chars);
 
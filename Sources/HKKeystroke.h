@@ -0,0 +1,79 @@
+/*
+ *  HKKeystroke.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_KEYSTROKE_H__)
+#define HK_KEYSTROKE_H__ 1
+
+#include "HKKeyMapContext.h"
+
+namespace hk {
+
+/* Virtual keycodes of the modifier keys (see kHKVirtual<name>Key in HKKeyMap.h) */
+enum : uint16_t {
+  kKeycodeCommand = 0x037,
+  kKeycodeShift = 0x038,
+  kKeycodeCapsLock = 0x039,
+  kKeycodeOption = 0x03A,
+  kKeycodeControl = 0x03B,
+};
+
+/*
+ Expands a keystroke into keyboard events: modifiers down, key down, key up, and modifiers up
+ in reverse order.
+ Post: void(uint16_t keycode, bool down), called for each event.
+ Returns the number of events posted.
+ */
+template<class Post>
+size_t PostKeystroke(Post &&post, uint16_t keycode, HKModifier modifier) {
+  size_t modifiers = 0;
+  /* Sending Modifier Keydown events */
+  if (kCGEventFlagMaskAlphaShift & modifier) {
+    /* Lock Caps Lock */
+    post(kKeycodeCapsLock, true);
+    modifiers++;
+  }
+  if (kCGEventFlagMaskShift & modifier) {
+    post(kKeycodeShift, true);
+    modifiers++;
+  }
+  if (kCGEventFlagMaskControl & modifier) {
+    post(kKeycodeControl, true);
+    modifiers++;
+  }
+  if (kCGEventFlagMaskAlternate & modifier) {
+    post(kKeycodeOption, true);
+    modifiers++;
+  }
+  if (kCGEventFlagMaskCommand & modifier) {
+    post(kKeycodeCommand, true);
+    modifiers++;
+  }
+
+  /* Sending Character Key events */
+  post(keycode, true);
+  post(keycode, false);
+
+  /* Sending Modifiers Key Up events */
+  if (kCGEventFlagMaskCommand & modifier)
+    post(kKeycodeCommand, false);
+  if (kCGEventFlagMaskAlternate & modifier)
+    post(kKeycodeOption, false);
+  if (kCGEventFlagMaskControl & modifier)
+    post(kKeycodeControl, false);
+  if (kCGEventFlagMaskShift & modifier)
+    post(kKeycodeShift, false);
+  if (kCGEventFlagMaskAlphaShift & modifier) {
+    /* Unlock Caps Lock */
+    post(kKeycodeCapsLock, false);
+  }
+  return 2 + 2 * modifiers;
+}
+
+} // namespace hk
+
+#endif /* HK_KEYSTROKE_H__ */
@@ -0,0 +1,107 @@
+/*
+ *  HKLayoutEpoch.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_LAYOUT_EPOCH_H__)
+#define HK_LAYOUT_EPOCH_H__ 1
+
+#include <stdint.h>
+
+#include <atomic>
+
+namespace hk {
+
+/*
+ Keyboard layout change detection.
+
+ A single change source (the selected input source notification on macOS) invalidates the epoch
+ each time the layout may have changed. Layout consumers remember the epoch of the layout they
+ use, so checking for a change before a lookup is a single atomic load, and the current layout is
+ only queried after an invalidation.
+ */
+class LayoutEpoch {
+public:
+  LayoutEpoch() = default;
+  LayoutEpoch(const LayoutEpoch &) = delete;
+  LayoutEpoch &operator=(const LayoutEpoch &) = delete;
+
+  /* Never 0, so 0 can be used as 'no epoch' */
+  uint32_t current() const { return _epoch.load(std::memory_order_acquire); }
+
+  /* Called by the change source, from any thread. Returns the new epoch */
+  uint32_t invalidate() {
+    uint32_t epoch = _epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+    /* wraps around to 1 (a consumer may miss a change only after 2^32 invalidations) */
+    if (!epoch) {
+      uint32_t expected = 0;
+      _epoch.compare_exchange_strong(expected, 1, std::memory_order_acq_rel);
+      epoch = 1;
+    }
+    return epoch;
+  }
+
+private:
+  std::atomic<uint32_t> _epoch { 1 };
+};
+
+/*
+ Current layout, as seen by a single consumer (not thread safe).
+
+ Traits:
+ typedef <layout type> Layout;   // Layout() is the null layout
+ static Layout Copy();           // returns the current layout (retained), may return Layout()
+ static bool Equal(Layout a, Layout b);
+ static void Release(Layout layout);
+ */
+template<class Traits>
+class LayoutCache {
+public:
+  typedef typename Traits::Layout Layout;
+
+  LayoutCache() = default;
+  LayoutCache(const LayoutCache &) = delete;
+  LayoutCache &operator=(const LayoutCache &) = delete;
+
+  ~LayoutCache() {
+    if (_layout != Layout())
+      Traits::Release(_layout);
+  }
+
+  /* true if the layout may have changed since the last update */
+  bool stale(const LayoutEpoch &source) const { return _epoch != source.current(); }
+
+  /* Queries the current layout if the epoch changed. Returns true if the layout changed */
+  bool update(const LayoutEpoch &source) {
+    uint32_t epoch = source.current();
+    if (epoch == _epoch)
+      return false;
+    /* read before the query: a change notified during the query invalidates this one */
+    _epoch = epoch;
+    Layout current = Traits::Copy();
+    if (_layout != Layout() && current != Layout() && Traits::Equal(current, _layout)) {
+      Traits::Release(current);
+      return false;
+    }
+    if (current == Layout() && _layout == Layout())
+      return false;
+    if (_layout != Layout())
+      Traits::Release(_layout);
+    _layout = current;
+    return true;
+  }
+
+  Layout layout() const { return _layout; }
+  uint32_t epoch() const { return _epoch; }
+
+private:
+  uint32_t _epoch = 0;
+  Layout _layout = Layout();
+};
+
+} // namespace hk
+
+#endif /* HK_LAYOUT_EPOCH_H__ */
@@ -0,0 +1,166 @@
+/*
+ *  HKSpecialKeys.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_SPECIAL_KEYS_H__)
+#define HK_SPECIAL_KEYS_H__ 1
+
+#include <stdint.h>
+
+/*
+ Special keys are keys that does not depend on the keyboard layout (function keys, navigation keys, …).
+ They are defined once here, and both lookup tables (keycode -> character and character -> keycode)
+ are generated at compile time from this list.
+
+ X(keycode name, unicode name, virtual keycode, character)
+ Names are the suffixes of the kHKVirtual<name>Key and kHK<name>Unicode constants (see HKKeyMap.h).
+ */
+#define HK_SPECIAL_KEYS(X) \
+  /* functions keys */ \
+  X(F1,  F1,  0x07A, 0xF704) \
+  X(F2,  F2,  0x078, 0xF705) \
+  X(F3,  F3,  0x063, 0xF706) \
+  X(F4,  F4,  0x076, 0xF707) \
+  X(F5,  F5,  0x060, 0xF708) \
+  X(F6,  F6,  0x061, 0xF709) \
+  X(F7,  F7,  0x062, 0xF70A) \
+  X(F8,  F8,  0x064, 0xF70B) \
+  X(F9,  F9,  0x065, 0xF70C) \
+  X(F10, F10, 0x06D, 0xF70D) \
+  X(F11, F11, 0x067, 0xF70E) \
+  X(F12, F12, 0x06F, 0xF70F) \
+  X(F13, F13, 0x069, 0xF710) \
+  X(F14, F14, 0x06B, 0xF711) \
+  X(F15, F15, 0x071, 0xF712) \
+  X(F16, F16, 0x06A, 0xF713) \
+  /* aluminium keyboard */ \
+  X(F17, F17, 0x040, 0xF714) \
+  X(F18, F18, 0x04F, 0xF715) \
+  X(F19, F19, 0x050, 0xF716) \
+  /* editing utility keys */ \
+  X(Help,          Help,          0x072, 0xF746) \
+  X(Delete,        Delete,        0x033, 0x007F) \
+  X(Tab,           Tab,           0x030, 0x0009) \
+  X(Enter,         Enter,         0x04C, 0x0003) \
+  X(Return,        Return,        0x024, 0x000D) \
+  X(Escape,        Escape,        0x035, 0x001B) \
+  X(ForwardDelete, ForwardDelete, 0x075, 0xF728) \
+  /* navigation keys */ \
+  X(Home,          Home,          0x073, 0xF729) \
+  X(End,           End,           0x077, 0xF72B) \
+  X(PageUp,        PageUp,        0x074, 0xF72C) \
+  X(PageDown,      PageDown,      0x079, 0xF72D) \
+  X(LeftArrow,     LeftArrow,     0x07B, 0xF702) \
+  X(RightArrow,    RightArrow,    0x07C, 0xF703) \
+  X(UpArrow,       UpArrow,       0x07E, 0xF700) \
+  X(DownArrow,     DownArrow,     0x07D, 0xF701) \
+  /* special num-pad key */ \
+  X(ClearLine,     ClearLine,     0x047, 0xF739)
+
+/* Characters that map to a special key, but that this key does not output (one way mapping). */
+#define HK_SPECIAL_KEY_ALIASES(X) \
+  X(Space, NoBreakSpace, 0x031, 0x00A0)
+
+namespace hk {
+
+constexpr uint16_t kSpecialKeyNilCharacter = 0xffff;
+constexpr uint16_t kSpecialKeyInvalidKeycode = 0xffff;
+
+struct __SpecialKey {
+  uint16_t keycode;
+  uint16_t character;
+  bool reversible;
+};
+
+#define __HK_SPECIAL_KEY_ENTRY(key, chr, keycode, character) { keycode, character, true },
+#define __HK_SPECIAL_KEY_ALIAS_ENTRY(key, chr, keycode, character) { keycode, character, false },
+constexpr __SpecialKey kSpecialKeys[] = {
+  HK_SPECIAL_KEYS(__HK_SPECIAL_KEY_ENTRY)
+  HK_SPECIAL_KEY_ALIASES(__HK_SPECIAL_KEY_ALIAS_ENTRY)
+};
+#undef __HK_SPECIAL_KEY_ENTRY
+#undef __HK_SPECIAL_KEY_ALIAS_ENTRY
+
+/*
+ Dense tables:
+ - characters: indexed by keycode (keycodes are 7 bits).
+ - keycodes: characters are split in 256 chars pages. 'pages' maps the high byte
+   of a character to a page in 'keycodes'. Page 0 is an empty page used for all
+   characters without special key.
+ */
+struct __SpecialKeyTables {
+  enum { kPageCount = 3 };
+
+  uint16_t characters[128];
+  uint8_t pages[256];
+  uint16_t keycodes[kPageCount][256];
+  uint8_t used; // pages used (including the empty page)
+};
+
+constexpr __SpecialKeyTables __SpecialKeyTablesCreate() {
+  __SpecialKeyTables tables{};
+  for (uint16_t &chr : tables.characters)
+    chr = kSpecialKeyNilCharacter;
+  for (auto &page : tables.keycodes)
+    for (uint16_t &code : page)
+      code = kSpecialKeyInvalidKeycode;
+
+  tables.used = 1;
+  for (const __SpecialKey &key : kSpecialKeys) {
+    uint8_t &page = tables.pages[key.character >> 8];
+    if (!page) {
+      /* when overflowing, generated table is broken and __SpecialKeyTablesCheck() fails */
+      if (tables.used >= __SpecialKeyTables::kPageCount)
+        return tables;
+      page = tables.used++;
+    }
+    tables.keycodes[page][key.character & 0xff] = key.keycode;
+    if (key.reversible && key.keycode < 128)
+      tables.characters[key.keycode] = key.character;
+  }
+  return tables;
+}
+
+constexpr __SpecialKeyTables kSpecialKeyTables = __SpecialKeyTablesCreate();
+
+/* Returns kSpecialKeyNilCharacter if keycode is not a special key */
+constexpr uint16_t SpecialCharacterForKeycode(uint16_t keycode) {
+  return keycode < 128 ? kSpecialKeyTables.characters[keycode] : kSpecialKeyNilCharacter;
+}
+
+/* Returns kSpecialKeyInvalidKeycode if character is not produced by a special key */
+constexpr uint16_t SpecialKeycodeForCharacter(uint16_t character) {
+  return kSpecialKeyTables.keycodes[kSpecialKeyTables.pages[character >> 8]][character & 0xff];
+}
+
+/* Compile time verification of the tables */
+constexpr bool __SpecialKeyTablesCheck() {
+  for (const __SpecialKey &key : kSpecialKeys) {
+    if (key.keycode >= 128 || key.character == kSpecialKeyNilCharacter)
+      return false;
+    /* also catches duplicated characters */
+    if (SpecialKeycodeForCharacter(key.character) != key.keycode)
+      return false;
+    /* also catches duplicated keycodes */
+    if (key.reversible != (SpecialCharacterForKeycode(key.keycode) == key.character))
+      return false;
+  }
+  /* round trip for all keycodes */
+  for (uint16_t keycode = 0; keycode < 128; keycode++) {
+    uint16_t chr = SpecialCharacterForKeycode(keycode);
+    if (chr != kSpecialKeyNilCharacter && SpecialKeycodeForCharacter(chr) != keycode)
+      return false;
+  }
+  return SpecialCharacterForKeycode(kSpecialKeyInvalidKeycode) == kSpecialKeyNilCharacter &&
+    SpecialKeycodeForCharacter(kSpecialKeyNilCharacter) == kSpecialKeyInvalidKeycode;
+}
+
+static_assert(__SpecialKeyTablesCheck(), "special keys table is not consistent");
+
+} // namespace hk
+
+#endif /* HK_SPECIAL_KEYS_H__ */
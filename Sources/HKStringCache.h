@@ -0,0 +1,135 @@
+/*
+ *  HKStringCache.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#if !defined(HK_STRING_CACHE_H__)
+#define HK_STRING_CACHE_H__ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace hk {
+
+enum ShortcutStyle : uint8_t {
+  kShortcutStyleSymbolic = 0,
+  kShortcutStyleSpeakable = 1,
+};
+
+/* Packed cache key:
+ --------------------------------------------------------------------
+ | epoch (32 bits) | style (8 bits) | modifiers (8 bits) | char (16) |
+ --------------------------------------------------------------------
+ The rendered string only depends on the character and the modifiers, so the keycode is not part
+ of the key (a shortcut and the same character without keycode share a single entry).
+ Only the device independent modifiers (bits 16 to 23 of the native modifiers) are used
+ to render a shortcut, so the other bits are ignored.
+ */
+constexpr uint64_t ShortcutStringKey(uint32_t epoch, uint32_t modifiers, uint16_t character, ShortcutStyle style) {
+  return (static_cast<uint64_t>(epoch) << 32) |
+    (static_cast<uint64_t>(style) << 24) |
+    (static_cast<uint64_t>((modifiers >> 16) & 0xff) << 16) | character;
+}
+
+/*
+ Bounded set associative cache of rendered shortcut strings.
+
+ The cache never allocates: kSets * kWays entries are reserved up front and the least recently
+ used entry of a set is replaced on insertion. As the layout epoch is part of the key, entries
+ rendered for a previous layout never match and are evicted as new entries are inserted.
+
+ Traits:
+ - Value: a pointer like type. A null Value means 'no entry'.
+ - static void Retain(Value value);
+ - static void Release(Value value);
+
+ The cache is not thread safe.
+ */
+template<class Traits, size_t kSets = 256, size_t kWays = 4>
+class ShortcutStringCache {
+  static_assert((kSets & (kSets - 1)) == 0, "set count must be a power of 2");
+public:
+  typedef typename Traits::Value Value;
+
+  ShortcutStringCache() = default;
+  ShortcutStringCache(const ShortcutStringCache &) = delete;
+  ShortcutStringCache &operator=(const ShortcutStringCache &) = delete;
+
+  ~ShortcutStringCache() { clear(); }
+
+  /* Returns null if not found */
+  Value lookup(uint64_t key) {
+    Entry *set = _entries[__Set(key)];
+    for (size_t idx = 0; idx < kWays; idx++) {
+      if (set[idx].value && set[idx].key == key) {
+        set[idx].tick = ++_tick;
+        _hits++;
+        return set[idx].value;
+      }
+    }
+    _misses++;
+    return Value();
+  }
+
+  void insert(uint64_t key, Value value) {
+    if (!value)
+      return;
+    Entry *set = _entries[__Set(key)];
+    Entry *victim = set;
+    for (size_t idx = 0; idx < kWays; idx++) {
+      /* already there, or empty slot */
+      if (!set[idx].value || set[idx].key == key) {
+        victim = &set[idx];
+        break;
+      }
+      if (set[idx].tick < victim->tick)
+        victim = &set[idx];
+    }
+    Traits::Retain(value);
+    if (victim->value)
+      Traits::Release(victim->value);
+    victim->key = key;
+    victim->value = value;
+    victim->tick = ++_tick;
+  }
+
+  void clear() {
+    for (auto &set : _entries) {
+      for (Entry &entry : set) {
+        if (entry.value)
+          Traits::Release(entry.value);
+        entry = Entry();
+      }
+    }
+  }
+
+  static constexpr size_t capacity() { return kSets * kWays; }
+
+  uint64_t hits() const { return _hits; }
+  uint64_t misses() const { return _misses; }
+
+private:
+  struct Entry {
+    uint64_t key = 0;
+    Value value = Value();
+    /* 64 bits, so the LRU order never wraps around */
+    uint64_t tick = 0;
+  };
+
+  static size_t __Set(uint64_t key) {
+    /* Fibonacci hashing. keys differ mostly by their low bits */
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & (kSets - 1);
+  }
+
+  Entry _entries[kSets][kWays];
+  uint64_t _tick = 0;
+  uint64_t _hits = 0;
+  uint64_t _misses = 0;
+};
+
+} // namespace hk
+
+#endif /* HK_STRING_CACHE_H__ */
@@ -28,6 +28,18 @@ NSString * const kHKEventModifierKey;
 HK_EXPORT
 NSString * const kHKEventCharacterKey;
 
+/*!
+ @abstract   A caught keystroke.
+ @field      keycode The virtual keycode.
+ @field      modifier Native modifiers (Caps Lock excluded).
+ @field      character The character produced by keycode without modifier.
+ */
+typedef struct {
+  HKKeycode keycode;
+  HKModifier modifier;
+  UniChar character;
+} HKTrapKeystroke;
+
 // MARK: -
 /*!
  @abstract   This Window can be use to record a Hot Key Event.
@@ -79,6 +91,14 @@ NSString * const kHKEventCharacterKey;
  */
 - (void)trapWindowDidCatchHotKey:(NSNotification *)aNotification;
 
+/*!
+ @method     trapWindow:didCatchKeystroke:
+ @abstract   Sent when the trap catch an Event.
+ @discussion When the delegate implements this method (or when the window has a keystroke handler),
+ the keystroke is delivered directly, and kHKTrapWindowDidCatchKeyNotification is not posted.
+ */
+- (void)trapWindow:(HKTrapWindow *)window didCatchKeystroke:(HKTrapKeystroke)keystroke;
+
 @end
 
 // MARK: -
@@ -88,6 +108,17 @@ HK_OBJC_EXPORT
 @property(nonatomic, getter=isTrapping) BOOL trapping;
 @property(nonatomic) BOOL verifyHotKey;
 
+/*!
+ @property
+ @abstract   Block called each time a keystroke is caught.
+ @discussion If set, the keystroke is delivered to this block only (the delegate and the notification are not used).
+ Nor the keystroke delivery, nor the hotkey verification allocate any object, so handling a keystroke does not
+ cause any allocation as long as the handler does not.
+ Hotkey verification results are cached until a hotkey is registred or unregistred, or the window starts trapping
+ or becomes key.
+ */
+@property(nonatomic, copy) void (^keystrokeHandler)(HKTrapKeystroke keystroke);
+
 /* simulate event (usefull when want to catch an already registred hotkey) */
 - (void)handleHotKey:(HKHotKey *)aKey;
 
@@ -24,7 +24,10 @@ NSString * const kHKTrapWindowDidCatchKeyNotification = @"kHKTrapWindowKeyCaught
     unsigned int trap:1;
     unsigned int resend:1;
     unsigned int skipverify:1;
-    unsigned int :29;
+    /* delegate methods */
+    unsigned int filter:1;
+    unsigned int keystroke:1;
+    unsigned int :27;
   } _twFlags;
 }
 
@@ -40,6 +43,8 @@ NSString * const kHKTrapWindowDidCatchKeyNotification = @"kHKTrapWindowKeyCaught
   if (delegate) {
     SPXDelegateRegisterNotification(delegate, @selector(trapWindowDidCatchHotKey:), kHKTrapWindowDidCatchKeyNotification);
   }
+  SPXFlagSet(_twFlags.filter, SPXDelegateHandle(delegate, trapWindow:isValidHotKey:modifier:));
+  SPXFlagSet(_twFlags.keystroke, SPXDelegateHandle(delegate, trapWindow:didCatchKeystroke:));
 }
 #pragma mark -
 #pragma mark Trap accessor
@@ -48,9 +53,18 @@ NSString * const kHKTrapWindowDidCatchKeyNotification = @"kHKTrapWindowKeyCaught
 }
 
 - (void)setTrapping:(BOOL)flag {
+  /* hotkeys registred by other applications may have changed */
+  if (flag && !_twFlags.trap)
+    HKHotKeyInvalidateCheckCache();
   SPXFlagSet(_twFlags.trap, flag);
 }
 
+- (void)becomeKeyWindow {
+  [super becomeKeyWindow];
+  /* hotkeys registred by other applications may have changed while an other window was key */
+  HKHotKeyInvalidateCheckCache();
+}
+
 - (BOOL)verifyHotKey {
   return !_twFlags.skipverify;
 }
@@ -60,6 +74,23 @@ NSString * const kHKTrapWindowDidCatchKeyNotification = @"kHKTrapWindowKeyCaught
 
 #pragma mark -
 #pragma mark Event Trap.
+HK_INLINE
+void _HKTrapWindowCatchKeystroke(HKTrapWindow *self, HKKeycode keycode, HKModifier modifier, UniChar character) {
+  HKTrapKeystroke keystroke = { keycode, modifier, character };
+  if (self->_keystrokeHandler) {
+    self->_keystrokeHandler(keystroke);
+  } else if (self->_twFlags.keystroke) {
+    [[self delegate] trapWindow:self didCatchKeystroke:keystroke];
+  } else {
+    NSDictionary *userInfo = @{ kHKEventKeyCodeKey: @(keycode),
+                                kHKEventModifierKey: @(modifier),
+                                kHKEventCharacterKey: @(character)};
+    [[NSNotificationCenter defaultCenter] postNotificationName:kHKTrapWindowDidCatchKeyNotification
+                                                        object:self
+                                                      userInfo:userInfo];
+  }
+}
+
 - (BOOL)performKeyEquivalent:(NSEvent *)theEvent {
   if (_twFlags.trap && !_twFlags.resend) {
     if (!SPXDelegateHandle([self delegate], trapWindow:shouldTrapKeyEquivalent:)
@@ -76,16 +107,14 @@ NSString * const kHKTrapWindowDidCatchKeyNotification = @"kHKTrapWindowKeyCaught
 - (void)handleHotKey:(HKHotKey *)aKey {
   if (_twFlags.trap) {
     bool valid = true;
-    if ([[self delegate] respondsToSelector:@selector(trapWindow:isValidHotKey:modifier:)])
+    if (_twFlags.filter)
       valid = [[self delegate] trapWindow:self isValidHotKey:aKey.keycode modifier:aKey.nativeModifier];
 
     if (valid) {
-      NSDictionary *userInfo = @{ kHKEventKeyCodeKey: @(aKey.keycode),
-                                  kHKEventModifierKey: @(aKey.modifier),
-                                  kHKEventCharacterKey: @(aKey.character)};
-      [[NSNotificationCenter defaultCenter] postNotificationName:kHKTrapWindowDidCatchKeyNotification
-                                                          object:self
-                                                        userInfo:userInfo];
+      if (_keystrokeHandler || _twFlags.keystroke)
+        _HKTrapWindowCatchKeystroke(self, aKey.keycode, aKey.nativeModifier, aKey.character);
+      else // legacy notification uses cocoa modifier
+        _HKTrapWindowCatchKeystroke(self, aKey.keycode, (HKModifier)aKey.modifier, aKey.character);
     }
   }
 }
@@ -115,11 +144,11 @@ NSString * const kHKTrapWindowDidCatchKeyNotification = @"kHKTrapWindowKeyCaught
   HKModifier modifier = (HKModifier)HKModifierConvert(mask, kHKModifierFormatCocoa, kHKModifierFormatNative);
   if ([self verifyHotKey]) {
     /* ask delegate if he want to filter the keycode and modifier */
-    if ([[self delegate] respondsToSelector:@selector(trapWindow:isValidHotKey:modifier:)])
+    if (_twFlags.filter)
       valid = [[self delegate] trapWindow:self isValidHotKey:code modifier:modifier];
     /* ask hotkey manager */
     if (valid)
-      valid = HKHotKeyCheckKeyCodeAndModifier(code, modifier);
+      valid = HKHotKeyCheckKeyCodeAndModifierCached(code, modifier);
   }
   if (valid) {
     character = [[HKKeyMap currentKeyMap] characterForKeycode:code];
@@ -134,14 +163,8 @@ NSString * const kHKTrapWindowDidCatchKeyNotification = @"kHKTrapWindowKeyCaught
     character = kHKNilUnichar;
     code = kHKInvalidVirtualKeyCode;
   }
-  if (code != kHKInvalidVirtualKeyCode) {
-    NSDictionary *userInfo = @{ kHKEventKeyCodeKey: @(code),
-                                kHKEventModifierKey: @(modifier),
-                                kHKEventCharacterKey: @(character)};
-    [[NSNotificationCenter defaultCenter] postNotificationName:kHKTrapWindowDidCatchKeyNotification
-                                                        object:self
-                                                      userInfo:userInfo];
-  }
+  if (code != kHKInvalidVirtualKeyCode)
+    _HKTrapWindowCatchKeystroke(self, code, modifier, character);
 }
 
 @end
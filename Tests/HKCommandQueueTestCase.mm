@@ -0,0 +1,166 @@
+/*
+ *  HKCommandQueueTestCase.mm
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#import "HKCommandQueueTestCase.h"
+
+#include "HKCommandQueue.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+struct TestCommand {
+  uint32_t producer;
+  uint32_t sequence;
+};
+
+/* Owner thread: drains the queue each time it is woken up */
+class Owner {
+public:
+  Owner() : queue([this] { __Wakeup(); }) {}
+
+  void start() {
+    _thread = std::thread([this] {
+      std::unique_lock<std::mutex> lock(_lock);
+      while (true) {
+        _cond.wait(lock, [this] { return _pending || _stop; });
+        if (!_pending && _stop)
+          break;
+        _pending = false;
+        lock.unlock();
+        queue.drain([this](TestCommand &command) { return execute(command); });
+        lock.lock();
+      }
+    });
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(_lock);
+      _stop = true;
+    }
+    _cond.notify_one();
+    _thread.join();
+  }
+
+  /* returns false if commands of a producer are executed out of order */
+  bool execute(const TestCommand &command) {
+    if (executed.size() <= command.producer)
+      executed.resize(command.producer + 1);
+    bool ordered = executed[command.producer] == command.sequence;
+    executed[command.producer] = command.sequence + 1;
+    return ordered;
+  }
+
+  hk::CommandQueue<TestCommand, bool> queue;
+  std::vector<uint32_t> executed; // owner thread only
+  std::atomic<uint32_t> wakeups { 0 };
+
+private:
+  void __Wakeup() {
+    wakeups.fetch_add(1, std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> lock(_lock);
+      _pending = true;
+    }
+    _cond.notify_one();
+  }
+
+  std::thread _thread;
+  std::mutex _lock;
+  std::condition_variable _cond;
+  bool _pending = false;
+  bool _stop = false;
+};
+
+}
+
+@implementation HKCommandQueueTestCase
+
+- (void)testMPSCQueue {
+  hk::MPSCQueue<int> queue;
+  int value = 0;
+  XCTAssertFalse(queue.pop(value));
+  for (int idx = 0; idx < 10; idx++)
+    queue.push(idx);
+  for (int idx = 0; idx < 10; idx++) {
+    XCTAssertTrue(queue.pop(value));
+    XCTAssertEqual(value, idx);
+  }
+  XCTAssertFalse(queue.pop(value));
+  queue.push(42);
+  XCTAssertTrue(queue.pop(value));
+  XCTAssertEqual(value, 42);
+  /* not drained: released by the destructor */
+  queue.push(1);
+}
+
+- (void)testBatchLimit {
+  int wakeups = 0;
+  hk::CommandQueue<int, int> queue([&wakeups] { wakeups++; });
+  std::vector<std::future<int>> futures;
+  for (int idx = 0; idx < 10; idx++)
+    futures.push_back(queue.submit(idx));
+  XCTAssertEqual(wakeups, 1, @"only the first command must wake the owner up");
+
+  auto twice = [](int &value) { return value * 2; };
+  XCTAssertEqual(queue.drain(twice, 4), 4U);
+  XCTAssertEqual(wakeups, 2, @"owner must be woken up again when commands are left");
+  XCTAssertEqual(futures[3].get(), 6);
+  XCTAssertEqual(queue.drain(twice), 6U);
+  XCTAssertEqual(wakeups, 2);
+  XCTAssertEqual(futures[9].get(), 18);
+  XCTAssertEqual(queue.drain(twice), 0U);
+
+  int completed = -1;
+  queue.submit(21, [&completed](const int &result) { completed = result; });
+  XCTAssertEqual(wakeups, 3);
+  XCTAssertEqual(completed, -1, @"completion must be called by drain");
+  queue.drain(twice);
+  XCTAssertEqual(completed, 42);
+  XCTAssertEqual(queue.batches(), 3U, @"empty drains must not be counted");
+  XCTAssertEqual(queue.executed(), 11U);
+}
+
+- (void)testProducers {
+  const uint32_t kProducers = 4;
+  const uint32_t kCommands = 10000;
+  Owner owner;
+  owner.start();
+
+  std::atomic<uint32_t> completed(0);
+  std::atomic<uint32_t> unordered(0);
+  std::vector<std::thread> producers;
+  for (uint32_t producer = 0; producer < kProducers; producer++) {
+    producers.emplace_back([&, producer] {
+      for (uint32_t sequence = 0; sequence < kCommands; sequence++) {
+        owner.queue.submit({ producer, sequence }, [&](const bool &ordered) {
+          if (!ordered)
+            unordered.fetch_add(1, std::memory_order_relaxed);
+          completed.fetch_add(1, std::memory_order_relaxed);
+        });
+      }
+    });
+  }
+  for (std::thread &producer : producers)
+    producer.join();
+
+  /* the last command of each producer is waited using a future */
+  std::future<bool> last = owner.queue.submit({ kProducers, 0 });
+  XCTAssertTrue(last.get());
+  owner.stop();
+
+  XCTAssertEqual(completed.load(), kProducers * kCommands);
+  XCTAssertEqual(unordered.load(), 0U, @"commands of a producer must be executed in order");
+  XCTAssertEqual(owner.queue.executed(), kProducers * kCommands + 1);
+  XCTAssertLessThanOrEqual(owner.queue.batches(), owner.wakeups.load());
+}
+
+@end
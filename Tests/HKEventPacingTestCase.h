@@ -0,0 +1,15 @@
+/*
+ *  HKEventPacingTestCase.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#import <XCTest/XCTest.h>
+
+@interface HKEventPacingTestCase : XCTestCase {
+
+}
+
+@end
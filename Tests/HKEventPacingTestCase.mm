@@ -0,0 +1,150 @@
+/*
+ *  HKEventPacingTestCase.mm
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#import "HKEventPacingTestCase.h"
+
+#include "HKEventPacing.h"
+
+namespace {
+
+/* A target consuming one event every `cost` ns, that drops events when `capacity` events are pending */
+struct SimulatedTarget {
+  uint64_t cost;
+  uint32_t capacity;
+  uint64_t busy = 0; // time at which all pending events are consumed
+
+  uint64_t pending(uint64_t now) const { return busy > now ? (busy - now + cost - 1) / cost : 0; }
+
+  bool post(uint64_t now) {
+    if (pending(now) >= capacity)
+      return false;
+    busy = std::max(busy, now) + cost;
+    return true;
+  }
+};
+
+struct RunResult {
+  uint64_t drops = 0;
+  uint64_t duration = 0;
+};
+
+/* Posts count events as fast as the pacer allows. The probe reports a lag when more than one event is pending */
+RunResult Run(hk::KeystrokePacer &pacer, SimulatedTarget &target, uint64_t &now, size_t count) {
+  RunResult result;
+  uint64_t start = now;
+  for (size_t idx = 0; idx < count; idx++) {
+    now = pacer.schedule(now);
+    if (!target.post(now)) {
+      result.drops++;
+      pacer.dropped(1);
+    } else if (pacer.probeDue()) {
+      if (target.pending(now) > 1)
+        pacer.lagging();
+      else
+        pacer.acknowledged();
+    }
+  }
+  result.duration = now - start;
+  return result;
+}
+
+}
+
+@implementation HKEventPacingTestCase
+
+- (void)testSchedule {
+  hk::PacingConfig config;
+  config.initialDelay = 1000;
+  hk::KeystrokePacer pacer(config);
+  XCTAssertEqual(pacer.schedule(5000), 5000U, @"the first event is not delayed");
+  XCTAssertEqual(pacer.schedule(5000), 1005000U);
+  /* the delay is a minimum interval, not a sleep after each event */
+  XCTAssertEqual(pacer.schedule(9000000), 9000000U);
+}
+
+- (void)testBackoff {
+  hk::PacingConfig config;
+  config.initialDelay = 400;
+  hk::KeystrokePacer pacer(config);
+  pacer.lagging();
+  XCTAssertEqual(pacer.delay(), 600U);
+  pacer.dropped(1);
+  XCTAssertEqual(pacer.delay(), 1200U);
+  XCTAssertEqual(pacer.state().floor, 750U);
+  XCTAssertEqual(pacer.drops(), 1U);
+  for (int idx = 0; idx < 100; idx++)
+    pacer.acknowledged();
+  XCTAssertEqual(pacer.delay(), 750U, @"speed up must stop at the floor");
+  for (int idx = 0; idx < 20; idx++)
+    pacer.dropped(1);
+  XCTAssertEqual(pacer.delay(), config.maxDelay);
+}
+
+- (void)testUnprobed {
+  hk::PacingConfig config;
+  config.initialDelay = 400;
+  hk::KeystrokePacer pacer(config, { 800, 0 });
+  for (int idx = 0; idx < 100; idx++) {
+    for (uint32_t event = 0; event < config.probeInterval; event++)
+      pacer.schedule(0);
+    XCTAssertTrue(pacer.probeDue());
+    pacer.unprobed();
+    XCTAssertFalse(pacer.probeDue());
+  }
+  XCTAssertEqual(pacer.delay(), 800U, @"a target that cannot be probed must not be sped up");
+  pacer.dropped(1);
+  XCTAssertEqual(pacer.delay(), 1600U);
+}
+
+- (void)testConvergence {
+  SimulatedTarget target = { 1000000 /* 1 ms */, 8 };
+  hk::KeystrokePacer pacer;
+  uint64_t now = 0;
+  RunResult warmup = Run(pacer, target, now, 1000);
+  XCTAssertTrue(warmup.drops > 0, @"the pacer must start faster than the target");
+  XCTAssertTrue(warmup.drops < 20);
+
+  RunResult steady = Run(pacer, target, now, 10000);
+  XCTAssertEqual(steady.drops, 0U, @"a converged pacer must not drop events");
+  uint64_t interval = steady.duration / 10000;
+  XCTAssertTrue(interval >= target.cost * 3 / 4);
+  /* faster than the fixed kHKEventDefaultLatency (3 ms per event) */
+  XCTAssertTrue(interval < 1500000, @"average interval: %llu ns", interval);
+}
+
+- (void)testMemory {
+  SimulatedTarget slow = { 2000000, 4 };
+  hk::PacingMemory memory;
+  {
+    hk::KeystrokePacer pacer(hk::PacingConfig(), memory.lookup("com.example.slow"));
+    uint64_t now = 0;
+    Run(pacer, slow, now, 1000);
+    memory.remember("com.example.slow", pacer.state());
+  }
+  XCTAssertTrue(memory.lookup("com.example.slow").delay >= 1000U);
+  XCTAssertEqual(memory.lookup("com.example.other").delay, 0U);
+
+  /* a new pacer for the same target starts at its safe rate */
+  SimulatedTarget target = { 2000000, 4 };
+  hk::KeystrokePacer pacer(hk::PacingConfig(), memory.lookup("com.example.slow"));
+  uint64_t now = 0;
+  XCTAssertEqual(Run(pacer, target, now, 1000).drops, 0U);
+}
+
+- (void)testDeterminism {
+  auto run = [] {
+    SimulatedTarget target = { 700000, 6 };
+    hk::KeystrokePacer pacer;
+    uint64_t now = 0;
+    RunResult result = Run(pacer, target, now, 5000);
+    return std::make_pair(result.duration, pacer.state().delay);
+  };
+  XCTAssertTrue(run() == run());
+}
+
+@end
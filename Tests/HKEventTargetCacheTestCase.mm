@@ -0,0 +1,122 @@
+/*
+ *  HKEventTargetCacheTestCase.mm
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#import "HKEventTargetCacheTestCase.h"
+
+#include "HKEventTargetCache.h"
+
+#include <map>
+
+namespace {
+
+struct FakeTraits {
+  typedef int Source;
+
+  static std::map<std::string, int32_t> running;
+  static int resolved;
+  static int sources;
+
+  static int32_t Resolve(const std::string &bundle) {
+    resolved++;
+    auto iter = running.find(bundle);
+    return iter != running.end() ? iter->second : -1;
+  }
+  static Source CreateSource() { return ++sources; }
+  static void ReleaseSource(Source source) { sources--; }
+};
+
+std::map<std::string, int32_t> FakeTraits::running;
+int FakeTraits::resolved = 0;
+int FakeTraits::sources = 0;
+
+typedef hk::EventTargetCache<FakeTraits> FakeCache;
+
+}
+
+@implementation HKEventTargetCacheTestCase
+
+- (void)setUp {
+  FakeTraits::running = { { "com.apple.TextEdit", 42 } };
+  FakeTraits::resolved = 0;
+  FakeTraits::sources = 0;
+}
+
+- (void)testResolveOnce {
+  FakeCache cache;
+  FakeCache::Target *target = cache.acquire("com.apple.TextEdit");
+  for (int idx = 0; idx < 100; idx++)
+    XCTAssertEqual(cache.resolve(target), 42);
+  XCTAssertEqual(FakeTraits::resolved, 1, @"bundle should be resolved only once");
+  XCTAssertEqual(cache.resolutions(), 1U);
+  cache.release(target);
+}
+
+- (void)testNotRunningIsCached {
+  FakeCache cache;
+  FakeCache::Target *target = cache.acquire("com.apple.Safari");
+  XCTAssertEqual(cache.resolve(target), -1);
+  XCTAssertEqual(cache.resolve(target), -1);
+  XCTAssertEqual(FakeTraits::resolved, 1);
+
+  /* launch */
+  FakeTraits::running["com.apple.Safari"] = 51;
+  cache.invalidate("com.apple.Safari");
+  XCTAssertEqual(cache.resolve(target), 51);
+  XCTAssertEqual(FakeTraits::resolved, 2);
+
+  /* terminate */
+  FakeTraits::running.erase("com.apple.Safari");
+  cache.invalidate("com.apple.Safari");
+  XCTAssertEqual(cache.resolve(target), -1);
+  XCTAssertEqual(FakeTraits::resolved, 3);
+  cache.release(target);
+}
+
+- (void)testInvalidateOnlyMatchingBundle {
+  FakeTraits::running["com.apple.Mail"] = 7;
+  FakeCache cache;
+  FakeCache::Target *edit = cache.acquire("com.apple.TextEdit");
+  FakeCache::Target *mail = cache.acquire("com.apple.Mail");
+  cache.resolve(edit);
+  cache.resolve(mail);
+  XCTAssertEqual(FakeTraits::resolved, 2);
+
+  cache.invalidate("com.apple.Mail");
+  cache.invalidate("com.apple.Unknown");
+  XCTAssertEqual(cache.resolve(edit), 42);
+  XCTAssertEqual(cache.resolve(mail), 7);
+  XCTAssertEqual(FakeTraits::resolved, 3, @"only mail should be resolved again");
+
+  cache.invalidateAll();
+  cache.resolve(edit);
+  cache.resolve(mail);
+  XCTAssertEqual(FakeTraits::resolved, 5);
+
+  cache.release(edit);
+  cache.release(mail);
+}
+
+- (void)testSharedTargetAndSourcePooling {
+  FakeCache cache;
+  FakeCache::Target *t1 = cache.acquire("com.apple.TextEdit");
+  FakeCache::Target *t2 = cache.acquire("com.apple.TextEdit");
+  XCTAssertTrue(t1 == t2, @"same bundle must share the target");
+  XCTAssertEqual(t1->source(), t2->source());
+  XCTAssertEqual(FakeTraits::sources, 1, @"one source per target");
+  XCTAssertEqual(cache.size(), 1U);
+
+  cache.release(t1);
+  XCTAssertEqual(cache.size(), 1U);
+  XCTAssertEqual(FakeTraits::sources, 1);
+
+  cache.release(t2);
+  XCTAssertEqual(cache.size(), 0U);
+  XCTAssertEqual(FakeTraits::sources, 0, @"source must be released with the last reference");
+}
+
+@end
@@ -0,0 +1,206 @@
+/*
+ *  HKEventTraceTestCase.mm
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#import "HKEventTraceTestCase.h"
+
+#include "HKEventReplay.h"
+
+#include <atomic>
+#include <thread>
+
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t kMs = 1000000;
+
+struct Invocation {
+  uint32_t hotkey;
+  uint64_t time;
+  bool repeat;
+};
+
+hk::TraceRecord Record(uint64_t ms, uint32_t hotkey, hk::TraceKind kind, uint16_t epoch = 1) {
+  return { ms * kMs, hotkey, kind, 0, epoch };
+}
+
+hk::ReplayStats Replay(const hk::Trace &trace, std::vector<Invocation> &invocations) {
+  return hk::TraceReplay(trace, [&](uint32_t hotkey, uint64_t time, bool repeat) {
+    invocations.push_back({ hotkey, time, repeat });
+  });
+}
+
+}
+
+@implementation HKEventTraceTestCase
+
+- (void)testReadWrite {
+  hk::Trace trace;
+  trace.hotkeys = { { 1, 0, 500000, 100000 }, { 2, hk::kTraceHotKeyInvokeOnKeyUp, 0, 0 } };
+  for (uint32_t idx = 0; idx < 1000; idx++)
+    trace.records.push_back(Record(idx, 1 + idx % 2, idx % 2 ? hk::kTraceKindReleased : hk::kTraceKindPressed));
+
+  FILE *f = tmpfile();
+  XCTAssertTrue(hk::TraceWrite(trace, f));
+  XCTAssertEqual(ftell(f), 16 + 16 * 2 + 16 * 1000);
+  rewind(f);
+
+  hk::Trace read;
+  XCTAssertTrue(hk::TraceRead(read, f));
+  fclose(f);
+
+  XCTAssertEqual(read.hotkeys.size(), trace.hotkeys.size());
+  XCTAssertEqual(read.records.size(), trace.records.size());
+  XCTAssertEqual(0, memcmp(read.hotkeys.data(), trace.hotkeys.data(), sizeof(hk::TraceHotKey) * trace.hotkeys.size()));
+  XCTAssertEqual(0, memcmp(read.records.data(), trace.records.data(), sizeof(hk::TraceRecord) * trace.records.size()));
+}
+
+- (void)testReadInvalid {
+  FILE *f = tmpfile();
+  fputs("not a trace file", f);
+  rewind(f);
+  hk::Trace trace;
+  XCTAssertFalse(hk::TraceRead(trace, f));
+  fclose(f);
+}
+
+- (void)testReadTruncated {
+  hk::Trace trace;
+  trace.hotkeys = { { 1, 0, 0, 0 } };
+  trace.records = { Record(0, 1, hk::kTraceKindPressed), Record(1, 1, hk::kTraceKindReleased) };
+  FILE *f = tmpfile();
+  XCTAssertTrue(hk::TraceWrite(trace, f));
+  XCTAssertEqual(fflush(f), 0);
+  long size = ftell(f);
+
+  /* truncated: the header counts do not match the file size */
+  XCTAssertEqual(ftruncate(fileno(f), size - 1), 0);
+  rewind(f);
+  hk::Trace read;
+  XCTAssertFalse(hk::TraceRead(read, f));
+
+  /* corrupted counts must be rejected without allocating */
+  uint32_t counts[2] = { UINT32_MAX, UINT32_MAX };
+  fseek(f, 8, SEEK_SET);
+  fwrite(counts, sizeof(counts), 1, f);
+  rewind(f);
+  XCTAssertFalse(hk::TraceRead(read, f));
+  XCTAssertTrue(read.records.empty());
+  fclose(f);
+}
+
+- (void)testRecorder {
+  hk::TraceRecorder &recorder = hk::TraceRecorder::shared();
+  recorder.record(1, 1, hk::kTraceKindPressed, 1);
+  XCTAssertFalse(recorder.isRecording());
+
+  recorder.start();
+  recorder.describe({ 1, 0, 0, 0 });
+  recorder.describe({ 1, hk::kTraceHotKeyInvokeOnKeyUp, 0, 0 });
+  /* records from an other thread are flushed when it exits */
+  std::thread thread([&recorder] {
+    for (uint64_t idx = 0; idx < 1000; idx++)
+      recorder.record(2 * idx + 1, 1, hk::kTraceKindReleased, 1);
+  });
+  thread.join();
+  for (uint64_t idx = 0; idx < 1000; idx++)
+    recorder.record(2 * idx, 1, hk::kTraceKindPressed, 1);
+  hk::Trace trace = recorder.stop();
+
+  XCTAssertFalse(recorder.isRecording());
+  XCTAssertEqual(trace.hotkeys.size(), 1U);
+  XCTAssertEqual(trace.hotkeys[0].flags, hk::kTraceHotKeyInvokeOnKeyUp);
+  XCTAssertEqual(trace.records.size(), 2000U);
+  for (size_t idx = 0; idx < trace.records.size(); idx++)
+    XCTAssertEqual(trace.records[idx].time, idx, @"records must be sorted");
+}
+
+- (void)testRecorderPendingRecords {
+  hk::TraceRecorder &recorder = hk::TraceRecorder::shared();
+  recorder.start();
+  std::atomic<int> step(0);
+  /* the thread is still running (and did not flush) when the recording stops */
+  std::thread thread([&recorder, &step] {
+    for (uint64_t idx = 0; idx < 10; idx++)
+      recorder.record(idx, 1, hk::kTraceKindPressed, 1);
+    step = 1;
+    while (step != 2)
+      std::this_thread::yield();
+  });
+  while (step != 1)
+    std::this_thread::yield();
+  hk::Trace trace = recorder.stop();
+  XCTAssertEqual(trace.records.size(), 10U);
+
+  /* collected records must not be collected again by the next session */
+  recorder.start();
+  step = 2;
+  thread.join();
+  trace = recorder.stop();
+  XCTAssertEqual(trace.records.size(), 0U);
+}
+
+- (void)testReplayRepeat {
+  hk::Trace trace;
+  /* initial: 500 ms, repeat: 100 ms */
+  trace.hotkeys = { { 1, 0, 500000, 100000 } };
+  trace.records = { Record(1000, 1, hk::kTraceKindPressed), Record(1800, 1, hk::kTraceKindReleased) };
+
+  std::vector<Invocation> invocations;
+  hk::ReplayStats stats = Replay(trace, invocations);
+  XCTAssertEqual(stats.events, 2U);
+  /* 1000 (press) then 1500, 1600, 1700. 1800 is released before the timer fires */
+  XCTAssertEqual(stats.invocations, 4U);
+  XCTAssertEqual(stats.repeats, 3U);
+  XCTAssertEqual(stats.duration, 800 * kMs);
+  XCTAssertEqual(invocations.size(), 4U);
+  XCTAssertFalse(invocations[0].repeat);
+  XCTAssertEqual(invocations[0].time, 1000 * kMs);
+  for (size_t idx = 1; idx < invocations.size(); idx++) {
+    XCTAssertTrue(invocations[idx].repeat);
+    XCTAssertEqual(invocations[idx].time, (1400 + 100 * idx) * kMs);
+  }
+}
+
+- (void)testReplayInvokeOnKeyUp {
+  hk::Trace trace;
+  trace.hotkeys = { { 1, hk::kTraceHotKeyInvokeOnKeyUp, 500000, 100000 } };
+  trace.records = { Record(0, 1, hk::kTraceKindPressed), Record(2000, 1, hk::kTraceKindReleased) };
+
+  std::vector<Invocation> invocations;
+  hk::ReplayStats stats = Replay(trace, invocations);
+  XCTAssertEqual(stats.invocations, 1U);
+  XCTAssertEqual(stats.repeats, 0U);
+  XCTAssertEqual(invocations[0].time, 2000 * kMs);
+}
+
+- (void)testReplayInterleaved {
+  hk::Trace trace;
+  trace.hotkeys = { { 1, 0, 100000, 100000 }, { 2, 0, 0, 0 } };
+  trace.records = {
+    Record(0, 1, hk::kTraceKindPressed),
+    Record(50, 2, hk::kTraceKindPressed),
+    Record(60, 2, hk::kTraceKindReleased),
+    Record(150, 3, hk::kTraceKindPressed, 2),
+    Record(200, 1, hk::kTraceKindRepeat, 2),
+    Record(250, 1, hk::kTraceKindReleased, 2),
+  };
+
+  std::vector<Invocation> invocations;
+  hk::ReplayStats stats = Replay(trace, invocations);
+  XCTAssertEqual(stats.unknown, 1U);
+  XCTAssertEqual(stats.recordedRepeats, 1U);
+  XCTAssertEqual(stats.layoutChanges, 1U);
+  XCTAssertEqual(stats.events, 4U);
+  /* 1 @ 0, 2 @ 50, 1 @ 100 (repeat), 1 @ 200 (repeat) */
+  XCTAssertEqual(invocations.size(), 4U);
+  XCTAssertEqual(invocations[1].hotkey, 2U);
+  XCTAssertEqual(stats.repeats, 2U);
+}
+
+@end
@@ -0,0 +1,96 @@
+/*
+ *  HKHotKeyRebindTestCase.mm
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#import "HKHotKeyRebindTestCase.h"
+
+#include "HKHotKeyRebind.h"
+
+namespace {
+
+/* 'a' (0x00), 'q' (0x0c), 'e' (0x0e), 'z' (0x06) and '^' (dead key 0x21 followed by space) */
+HKKeyMapContext *CreateQwerty() {
+  HKKeyMapContext *ctxt = new HKKeyMapContext();
+  __HKMapInsertIfBetter(ctxt->chars, 'a', 0x00, 0, 0);
+  __HKMapInsertIfBetter(ctxt->chars, 'q', 0x0c, 0, 0);
+  __HKMapInsertIfBetter(ctxt->chars, 'e', 0x0e, 0, 0);
+  __HKMapInsertIfBetter(ctxt->chars, 'z', 0x06, 0, 0);
+  __HKMapInsertIfBetter(ctxt->stats, 1, 0x21, 0, 0);
+  ctxt->chars.try_emplace('^', __HKUtilsFlatKey(0x31, 0, 1));
+  return ctxt;
+}
+
+/* 'a' and 'q' swapped, no 'z', and '^' on an other dead key */
+HKKeyMapContext *CreateAzerty() {
+  HKKeyMapContext *ctxt = new HKKeyMapContext();
+  __HKMapInsertIfBetter(ctxt->chars, 'a', 0x0c, 0, 0);
+  __HKMapInsertIfBetter(ctxt->chars, 'q', 0x00, 0, 0);
+  __HKMapInsertIfBetter(ctxt->chars, 'e', 0x0e, 0, 0);
+  __HKMapInsertIfBetter(ctxt->stats, 1, 0x1e, 0, 0);
+  ctxt->chars.try_emplace('^', __HKUtilsFlatKey(0x31, 0, 1));
+  return ctxt;
+}
+
+}
+
+@implementation HKHotKeyRebindTestCase
+
+- (void)testResolveKeycode {
+  HKKeyMapContext *ctxt = CreateQwerty();
+  XCTAssertEqual(hk::ResolveKeycode(ctxt, 'q'), 0x0c);
+  XCTAssertEqual(hk::ResolveKeycode(ctxt, '^'), 0x21, @"dead key followed by space must resolve to the dead key");
+  XCTAssertEqual(hk::ResolveKeycode(ctxt, 'w'), hk::kRebindInvalidKeycode);
+  XCTAssertEqual(hk::ResolveKeycode(nullptr, 'q'), hk::kRebindInvalidKeycode);
+  HKKeyMapContextDealloc(ctxt);
+}
+
+- (void)testDiffBindings {
+  HKKeyMapContext *previous = CreateQwerty();
+  HKKeyMapContext *current = CreateAzerty();
+  std::vector<hk::KeycodeBinding> bindings = {
+    { 'a', 0x00, kCGEventFlagMaskCommand },
+    { 'e', 0x0e, kCGEventFlagMaskCommand },
+    { 'q', 0x0c, kCGEventFlagMaskCommand | kCGEventFlagMaskShift },
+    { 'a', 0x00, kCGEventFlagMaskControl },
+    { '^', 0x21, kCGEventFlagMaskCommand },
+  };
+  std::vector<hk::KeycodeChange> changes = hk::DiffBindings(previous, current, bindings);
+  XCTAssertEqual(changes.size(), 4U);
+  XCTAssertEqual(changes[0].index, 0U);
+  XCTAssertEqual(changes[0].keycode, 0x0c);
+  XCTAssertEqual(changes[1].index, 2U);
+  XCTAssertEqual(changes[1].keycode, 0x00);
+  XCTAssertEqual(changes[2].index, 3U);
+  XCTAssertEqual(changes[2].keycode, 0x0c);
+  XCTAssertEqual(changes[3].index, 4U);
+  XCTAssertEqual(changes[3].keycode, 0x1e);
+
+  /* same layout: nothing to rebind */
+  XCTAssertTrue(hk::DiffBindings(previous, previous, bindings).empty());
+  HKKeyMapContextDealloc(previous);
+  HKKeyMapContextDealloc(current);
+}
+
+- (void)testDiffKeepsUnresolvedBindings {
+  HKKeyMapContext *previous = CreateQwerty();
+  HKKeyMapContext *current = CreateAzerty();
+  std::vector<hk::KeycodeBinding> bindings = {
+    /* not available in the current layout */
+    { 'z', 0x06, kCGEventFlagMaskCommand },
+    /* keycode not resolved from the character */
+    { 'a', 0x05, kCGEventFlagMaskCommand },
+    /* keycode bindings */
+    { '1', 0x12, kCGEventFlagMaskCommand },
+    { 'q', 0x0c, kCGEventFlagMaskNumericPad },
+    { 'q', 0x0c, kCGEventFlagMaskSecondaryFn },
+  };
+  XCTAssertTrue(hk::DiffBindings(previous, current, bindings).empty());
+  HKKeyMapContextDealloc(previous);
+  HKKeyMapContextDealloc(current);
+}
+
+@end
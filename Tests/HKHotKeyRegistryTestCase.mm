@@ -0,0 +1,169 @@
+/*
+ *  HKHotKeyRegistryTestCase.mm
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#import "HKHotKeyRegistryTestCase.h"
+
+#include "HKHotKeyRegistry.h"
+
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct FakeHotKey {
+  int keystroke;
+};
+
+/* Fake platform: refuses duplicated keystrokes */
+struct FakePlatform {
+  std::mutex lock;
+  std::multiset<int> keystrokes;
+  int handlers = 0;
+  bool refuseHandler = false;
+};
+
+FakePlatform *sPlatform = nullptr;
+
+struct FakeRegistryTraits {
+  typedef FakeHotKey *HotKey;
+  typedef int Ref;
+  typedef std::hash<FakeHotKey *> Hash;
+
+  static bool Register(FakeHotKey *hotkey, uint32_t, int *ref) {
+    std::lock_guard<std::mutex> lock(sPlatform->lock);
+    if (sPlatform->keystrokes.count(hotkey->keystroke))
+      return false;
+    sPlatform->keystrokes.insert(hotkey->keystroke);
+    *ref = hotkey->keystroke;
+    return true;
+  }
+  static bool Unregister(FakeHotKey *, int ref) {
+    std::lock_guard<std::mutex> lock(sPlatform->lock);
+    auto iter = sPlatform->keystrokes.find(ref);
+    if (iter == sPlatform->keystrokes.end())
+      return false;
+    sPlatform->keystrokes.erase(iter);
+    return true;
+  }
+  static bool InstallHandler() {
+    std::lock_guard<std::mutex> lock(sPlatform->lock);
+    if (sPlatform->refuseHandler)
+      return false;
+    sPlatform->handlers++;
+    return true;
+  }
+  static void UninstallHandler() {
+    std::lock_guard<std::mutex> lock(sPlatform->lock);
+    sPlatform->handlers--;
+  }
+};
+
+typedef hk::HotKeyRegistry<FakeRegistryTraits> FakeRegistry;
+
+}
+
+@implementation HKHotKeyRegistryTestCase
+
+- (void)setUp {
+  sPlatform = new FakePlatform();
+}
+
+- (void)tearDown {
+  delete sPlatform;
+  sPlatform = nullptr;
+}
+
+- (void)testRegistration {
+  FakeRegistry registry;
+  FakeHotKey a = { 1 }, b = { 2 }, duplicate = { 1 };
+
+  uint32_t uid = registry.add(&a);
+  XCTAssertNotEqual(uid, 0U);
+  XCTAssertEqual(sPlatform->handlers, 1, @"handler must be installed with the first hotkey");
+  XCTAssertEqual(registry.add(&a), 0U, @"hotkey already registered");
+  XCTAssertEqual(registry.add(&duplicate), 0U, @"keystroke refused by the platform");
+  XCTAssertFalse(registry.contains(&duplicate));
+
+  uint32_t other = registry.add(&b);
+  XCTAssertNotEqual(other, 0U);
+  XCTAssertNotEqual(other, uid);
+  XCTAssertEqual(sPlatform->handlers, 1);
+
+  XCTAssertEqual(registry.find(uid), &a);
+  XCTAssertEqual(registry.find(other), &b);
+  XCTAssertEqual(registry.uid(&b), other);
+  XCTAssertEqual(registry.size(), 2U);
+
+  XCTAssertTrue(registry.remove(&a));
+  XCTAssertFalse(registry.remove(&a));
+  XCTAssertTrue(registry.find(uid) == nullptr);
+  XCTAssertEqual(sPlatform->handlers, 1);
+  XCTAssertTrue(registry.remove(&b));
+  XCTAssertEqual(sPlatform->handlers, 0, @"handler must be removed with the last hotkey");
+  XCTAssertTrue(sPlatform->keystrokes.empty());
+
+  /* uids are not reused */
+  XCTAssertNotEqual(registry.add(&a), uid);
+}
+
+- (void)testClear {
+  FakeRegistry registry;
+  std::vector<FakeHotKey> hotkeys(100);
+  for (size_t idx = 0; idx < hotkeys.size(); idx++) {
+    hotkeys[idx].keystroke = static_cast<int>(idx);
+    XCTAssertNotEqual(registry.add(&hotkeys[idx]), 0U);
+  }
+  XCTAssertEqual(registry.clear(), 100U);
+  XCTAssertEqual(registry.size(), 0U);
+  XCTAssertTrue(sPlatform->keystrokes.empty());
+  XCTAssertEqual(sPlatform->handlers, 0);
+  XCTAssertEqual(registry.clear(), 0U);
+  XCTAssertEqual(sPlatform->handlers, 0);
+}
+
+- (void)testHandlerFailure {
+  FakeRegistry registry;
+  FakeHotKey a = { 1 };
+  sPlatform->refuseHandler = true;
+  XCTAssertEqual(registry.add(&a), 0U);
+  XCTAssertTrue(sPlatform->keystrokes.empty(), @"hotkey must be unregistered if the handler cannot be installed");
+  XCTAssertEqual(registry.size(), 0U);
+}
+
+- (void)testConcurrentRegistration {
+  FakeRegistry registry;
+  std::vector<FakeHotKey> hotkeys(1000);
+  for (size_t idx = 0; idx < hotkeys.size(); idx++)
+    hotkeys[idx].keystroke = static_cast<int>(idx);
+
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread < 4; thread++) {
+    threads.emplace_back([&registry, &hotkeys, thread] {
+      for (int round = 0; round < 10; round++) {
+        for (size_t idx = thread; idx < hotkeys.size(); idx += 2) {
+          if (!registry.add(&hotkeys[idx]))
+            registry.remove(&hotkeys[idx]);
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+
+  std::set<uint32_t> uids;
+  registry.withRecords([&](const FakeRegistry::Records &records) {
+    for (const auto &iter : records)
+      uids.insert(iter.second.uid);
+  });
+  XCTAssertEqual(uids.size(), registry.size(), @"uids must be unique");
+  XCTAssertEqual(sPlatform->keystrokes.size(), registry.size());
+  XCTAssertEqual(sPlatform->handlers, registry.size() ? 1 : 0);
+}
+
+@end
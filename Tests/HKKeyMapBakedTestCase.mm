@@ -0,0 +1,160 @@
+/*
+ *  HKKeyMapBakedTestCase.mm
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#import "HKKeyMapBakedTestCase.h"
+
+#include "HKKeyMapBaked.h"
+
+#if !defined(__APPLE__)
+#include "HKKeyMapXKB.h"
+
+#include <string>
+#endif
+
+namespace {
+
+/* 'a' (0x00), 'A' (shift 0x00), dead circumflex (0x21) and '^e' -> 'ê' */
+HKKeyMapContext *CreateContext() {
+  HKKeyMapContext *ctxt = new HKKeyMapContext();
+  __HKMapInsertIfBetter(ctxt->chars, 'a', 0x00, 0, 0);
+  __HKMapInsertIfBetter(ctxt->chars, 'A', 0x00, kCGEventFlagMaskShift, 0);
+  __HKMapInsertIfBetter(ctxt->chars, 'e', 0x0e, 0, 0);
+  __HKMapInsertIfBetter(ctxt->stats, 1, 0x21, 0, 0);
+  ctxt->chars.try_emplace(0x00ea, __HKUtilsFlatKey(0x0e, 0, 1));
+  ctxt->map[0x00] = 'a';
+  ctxt->map[0x0e] = 'e';
+  ctxt->keys[__HKUtilsFlatKey(0x00, kCGEventFlagMaskShift, 0)] = 'A';
+  ctxt->keys[__HKUtilsFlatKey(0x21, 0, 0)] = '^';
+  return ctxt;
+}
+
+UniChar TranslateUppercase(const HKKeyMapContext *ctxt, HKKeycode keycode, HKModifier modifier) {
+  if (keycode >= 128 || ctxt->map[keycode] == hk::kKeyMapNilCharacter)
+    return hk::kKeyMapNilCharacter;
+  return modifier & kCGEventFlagMaskShift ? static_cast<UniChar>(ctxt->map[keycode] - 'a' + 'A') : ctxt->map[keycode];
+}
+
+#if !defined(__APPLE__)
+/* Tests/Fixtures/Layouts/<name>.xkb */
+bool ReadFixture(const char *name, std::string &text) {
+  std::string path(__FILE__);
+  path.erase(path.find_last_of('/') + 1).append("Fixtures/Layouts/").append(name).append(".xkb");
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  char buffer[4096];
+  size_t length;
+  while ((length = fread(buffer, 1, sizeof(buffer), f)) > 0)
+    text.append(buffer, length);
+  bool ok = !ferror(f);
+  fclose(f);
+  return ok;
+}
+#endif
+
+}
+
+@implementation HKKeyMapBakedTestCase
+
+- (void)testBakedContextMatchesRuntimeContext {
+  HKKeyMapContext *ctxt = CreateContext();
+  hk::BakedTables tables = hk::BakeContext(ctxt);
+  XCTAssertEqual(tables.chars.size(), ctxt->chars.size());
+  XCTAssertEqual(tables.states.size(), ctxt->stats.size());
+  XCTAssertEqual(tables.keys.size(), ctxt->keys.size());
+  for (size_t idx = 1; idx < tables.chars.size(); idx++)
+    XCTAssertTrue(tables.chars[idx - 1].key < tables.chars[idx].key, @"baked tables must be sorted");
+
+  hk::BakedLayout layout = {
+    "test", "", 42, {},
+    tables.chars.data(), static_cast<uint32_t>(tables.chars.size()),
+    tables.states.data(), static_cast<uint32_t>(tables.states.size()),
+    tables.keys.data(), static_cast<uint32_t>(tables.keys.size()),
+  };
+  memcpy(layout.map, tables.map, sizeof(layout.map));
+  HKKeyMapContext baked;
+  baked.baked = &layout;
+  memcpy(baked.map, layout.map, sizeof(baked.map));
+
+  XCTAssertTrue(hk::BakedTablesEqual(hk::BakeContext(&baked), tables), @"baked tables must match the runtime compilation byte-for-byte");
+
+  const UniChar characters[] = { 'a', 'A', 'e', 0x00ea, 'z' };
+  for (UniChar chr : characters) {
+    HKKeycode keys[4], bkeys[4];
+    HKModifier modifiers[4], bmodifiers[4];
+    size_t count = HKKeycodesForCharacterFunction(ctxt, chr, keys, modifiers, 4);
+    XCTAssertEqual(HKKeycodesForCharacterFunction(&baked, chr, bkeys, bmodifiers, 4), count);
+    for (size_t idx = 0; idx < count; idx++) {
+      XCTAssertEqual(bkeys[idx], keys[idx]);
+      XCTAssertEqual(bmodifiers[idx], modifiers[idx]);
+    }
+  }
+  const HKModifier modifiers[] = { 0, kCGEventFlagMaskShift, kCGEventFlagMaskShift | kCGEventFlagMaskCommand, kCGEventFlagMaskAlternate };
+  for (HKModifier modifier : modifiers) {
+    for (HKKeycode keycode = 0; keycode < 128; keycode++)
+      XCTAssertEqual(HKCharacterForKeyCodeFunction(&baked, keycode, modifier), HKCharacterForKeyCodeFunction(ctxt, keycode, modifier));
+  }
+
+  /* static contexts must not be released */
+  HKKeyMapContextDealloc(&baked);
+  HKKeyMapContextDealloc(ctxt);
+}
+
+- (void)testTranslateContextsAreBakedWithKeys {
+  HKKeyMapContext *ctxt = CreateContext();
+  ctxt->keys.clear();
+  ctxt->translate = TranslateUppercase;
+  hk::BakedTables tables = hk::BakeContext(ctxt);
+  /* 'a' and 'e', with and without shift and for each combination of caps lock and option */
+  XCTAssertEqual(tables.keys.size(), 16U);
+  const hk::BakedEntry *entry = hk::BakedFind(tables.keys.data(), static_cast<uint32_t>(tables.keys.size()), __HKUtilsFlatKey(0x0e, kCGEventFlagMaskShift, 0));
+  XCTAssertTrue(entry && entry->value == 'E');
+  HKKeyMapContextDealloc(ctxt);
+}
+
+- (void)testLinkedLayoutsMatchFixtures {
+#if defined(__APPLE__)
+  XCTSkip(@"baked layouts are XKB only (see HKKeyMapBaked.h)");
+#else
+  size_t count = 0;
+  for (const hk::BakedLayout *const *layout = hk::kBakedLayouts; *layout; layout++, count++) {
+    const char *name = (*layout)->name;
+    HKKeyMapContext *baked = HKKeyMapContextGetBaked((*layout)->hash);
+    XCTAssertTrue(baked && baked->baked == *layout);
+    for (uint32_t idx = 1; idx < (*layout)->charCount; idx++)
+      XCTAssertTrue((*layout)->chars[idx - 1].key < (*layout)->chars[idx].key, @"%s: baked tables must be sorted", name);
+
+    std::string text;
+    XCTAssertTrue(ReadFixture(name, text), @"%s: missing fixture", name);
+    /* layouts baked for any locale must not depend on the compose table */
+    const char *locale = *(*layout)->locale ? (*layout)->locale : "C";
+    XCTAssertTrue(HKKeyMapContextGetBakedXKB(text.data(), text.size(), locale) == baked, @"%s (%s): not found by the keymap lookup", name, locale);
+    HKKeyMapContext *ctxt = HKKeyMapContextCreateWithXKBString(text.data(), text.size(), locale);
+    XCTAssertTrue(ctxt != NULL, @"%s: compilation failed", name);
+    if (baked && ctxt)
+      XCTAssertTrue(hk::BakedTablesEqual(hk::BakeContext(baked), hk::BakeContext(ctxt)), @"%s (%s): baked tables differ from the runtime compilation", name, locale);
+    if (ctxt)
+      HKKeyMapContextDealloc(ctxt);
+  }
+  XCTAssertGreaterThan(count, 0U, @"no baked layout to check");
+  XCTAssertTrue(HKKeyMapContextGetBaked(0) == NULL);
+#endif
+}
+
+- (void)testLayoutHash {
+  const char data[] = "keymap data: not a multiple of 8 bytes";
+  uint64_t hash = HKKeyMapLayoutHash(data, sizeof(data), 0);
+  XCTAssertEqual(HKKeyMapLayoutHash(data, sizeof(data), 0), hash);
+  XCTAssertNotEqual(HKKeyMapLayoutHash(data, sizeof(data), 40), hash, @"the seed must change the hash");
+  char copy[sizeof(data)];
+  memcpy(copy, data, sizeof(data));
+  copy[sizeof(copy) - 2] = '!';
+  XCTAssertNotEqual(HKKeyMapLayoutHash(copy, sizeof(copy), 0), hash, @"trailing bytes must be hashed");
+}
+
+@end
@@ -0,0 +1,201 @@
+/*
+ *  HKKeyMapContextTestCase.mm
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#import "HKKeyMapContextTestCase.h"
+
+#include "HKKeyMapContext.h"
+
+namespace {
+
+/* Minimal layout: 'a' (0x00), 'A' (shift 0x00), dead circumflex (0x21), 'e' (0x0e) and '^e' -> 'ê' */
+HKKeyMapContext *CreateContext() {
+  HKKeyMapContext *ctxt = new HKKeyMapContext();
+  __HKMapInsertIfBetter(ctxt->chars, 'a', 0x00, 0, 0);
+  __HKMapInsertIfBetter(ctxt->chars, 'A', 0x00, kCGEventFlagMaskShift | kCGEventFlagMaskAlternate, 0);
+  __HKMapInsertIfBetter(ctxt->chars, 'A', 0x00, kCGEventFlagMaskShift, 0);
+  __HKMapInsertIfBetter(ctxt->chars, 'A', 0x0e, kCGEventFlagMaskShift | kCGEventFlagMaskAlphaShift, 0);
+  __HKMapInsertIfBetter(ctxt->chars, 'e', 0x0e, 0, 0);
+  __HKMapInsertIfBetter(ctxt->stats, 1, 0x21, 0, 0);
+  ctxt->chars.try_emplace(0x00ea, __HKUtilsFlatKey(0x0e, 0, 1));
+  __HKMapInsertIfBetter(ctxt->chars, '\r', 0x24, 0, 0);
+  __HKUtilsNormalizeEndOfLine(ctxt->chars);
+
+  ctxt->map[0x00] = 'a';
+  ctxt->map[0x0e] = 'e';
+  ctxt->keys[__HKUtilsFlatKey(0x00, kCGEventFlagMaskShift, 0)] = 'A';
+  return ctxt;
+}
+
+/*
+ Dead keys graph: circumflex (state 1) on 0x21 or shift + option 0x21, diaeresis (state 2) on
+ shift + option 0x27, or circumflex then 0x22. 'ê' is also on shift + option 0x13.
+ Keystrokes are added with the most expensive first, so order does not hide the plan choice.
+ */
+HKKeyMapContext *CreatePlannedContext(const hk::KeystrokeWeights &weights) {
+  const HKModifier kShiftOption = kCGEventFlagMaskShift | kCGEventFlagMaskAlternate;
+  hk::KeystrokePlanner planner(weights);
+  planner.addOutput(0, 0x0e, 0, 'e');
+  planner.addOutput(0, 0x13, kShiftOption, 0x00ea);
+  planner.addTransition(0, 0x21, kShiftOption, 1);
+  planner.addTransition(0, 0x21, 0, 1);
+  planner.addTransition(0, 0x27, kShiftOption, 2);
+  planner.addTransition(1, 0x22, 0, 2);
+  /* loop between dead states */
+  planner.addTransition(2, 0x21, 0, 1);
+  planner.addOutput(1, 0x0e, 0, 0x00ea);
+  planner.addOutput(2, 0x0e, 0, 0x00eb);
+  /* state without transition */
+  planner.addOutput(5, 0x0e, 0, 0x0115);
+
+  HKKeyMapContext *ctxt = new HKKeyMapContext();
+  planner.compile(ctxt);
+  return ctxt;
+}
+
+}
+
+@implementation HKKeyMapContextTestCase
+
+- (void)testFlatKey {
+  HKKeycode code;
+  HKModifier modifier;
+  uint16_t dead;
+  uint32_t flat = __HKUtilsFlatKey(0, kCGEventFlagMaskShift | kCGEventFlagMaskCommand, 42);
+  XCTAssertNotEqual(flat, 0U, @"keycode 0 must not produce an invalid flat key");
+  __HKUtilsDeflatKey(flat, &code, &modifier, &dead);
+  XCTAssertEqual(code, 0);
+  XCTAssertEqual(modifier, (HKModifier)(kCGEventFlagMaskShift | kCGEventFlagMaskCommand));
+  XCTAssertEqual(dead, 42);
+  XCTAssertEqual(__HKUtilsFlatDead(flat, 3), __HKUtilsFlatKey(0, kCGEventFlagMaskShift | kCGEventFlagMaskCommand, 3));
+}
+
+- (void)testReverseLookup {
+  HKKeyMapContext *ctxt = CreateContext();
+  HKKeycode keys[4];
+  HKModifier modifiers[4];
+
+  XCTAssertEqual(HKKeycodesForCharacterFunction(ctxt, 'A', keys, modifiers, 4), 1U);
+  XCTAssertEqual(keys[0], 0x00);
+  XCTAssertEqual(modifiers[0], (HKModifier)kCGEventFlagMaskShift, @"the keystroke with less modifiers must be kept");
+
+  /* dead key: the dead keystroke comes first */
+  XCTAssertEqual(HKKeycodesForCharacterFunction(ctxt, 0x00ea, keys, modifiers, 4), 2U);
+  XCTAssertEqual(keys[0], 0x21);
+  XCTAssertEqual(keys[1], 0x0e);
+
+  /* end of line normalization */
+  XCTAssertEqual(HKKeycodesForCharacterFunction(ctxt, '\n', keys, modifiers, 4), 1U);
+  XCTAssertEqual(keys[0], 0x24);
+
+  XCTAssertEqual(HKKeycodesForCharacterFunction(ctxt, 'z', keys, modifiers, 4), 0U);
+  HKKeyMapContextDealloc(ctxt);
+}
+
+- (void)testKeystrokePlanner {
+  HKKeyMapContext *ctxt = CreatePlannedContext(hk::KeystrokeWeights());
+  HKKeycode keys[4];
+  HKModifier modifiers[4];
+
+  XCTAssertEqual(HKKeycodesForCharacterFunction(ctxt, 'e', keys, modifiers, 4), 1U);
+  XCTAssertEqual(keys[0], 0x0e);
+
+  XCTAssertEqual(HKKeycodesForCharacterFunction(ctxt, 0x00ea, keys, modifiers, 4), 1U, @"a single keystroke must be preferred to a dead key");
+  XCTAssertEqual(keys[0], 0x13);
+
+  XCTAssertEqual(HKKeycodesForCharacterFunction(ctxt, 0x00eb, keys, modifiers, 4), 2U);
+  XCTAssertEqual(keys[0], 0x27);
+  XCTAssertEqual(keys[1], 0x0e);
+
+  XCTAssertEqual(HKKeycodesForCharacterFunction(ctxt, 0x0115, keys, modifiers, 4), 0U, @"unreachable state");
+  XCTAssertEqual(ctxt->stats.size(), 2U);
+  uint16_t dead;
+  __HKUtilsDeflatKey(ctxt->stats[1], &keys[0], &modifiers[0], &dead);
+  XCTAssertEqual(keys[0], 0x21);
+  XCTAssertEqual(modifiers[0], 0U, @"the dead keystroke with less modifiers must be kept");
+  XCTAssertEqual(dead, 0);
+  HKKeyMapContextDealloc(ctxt);
+}
+
+- (void)testKeystrokePlannerWeights {
+  /* modifiers are expensive, dead keys are free */
+  hk::KeystrokeWeights weights;
+  weights.keystroke = 1;
+  weights.modifier = 10;
+  weights.dead = 0;
+  HKKeyMapContext *ctxt = CreatePlannedContext(weights);
+  HKKeycode keys[4];
+  HKModifier modifiers[4];
+
+  XCTAssertEqual(HKKeycodesForCharacterFunction(ctxt, 0x00ea, keys, modifiers, 4), 2U);
+  XCTAssertEqual(keys[0], 0x21);
+  XCTAssertEqual(keys[1], 0x0e);
+
+  /* two dead keys without modifier are cheaper than one with two */
+  XCTAssertEqual(HKKeycodesForCharacterFunction(ctxt, 0x00eb, keys, modifiers, 4), 3U);
+  XCTAssertEqual(keys[0], 0x21);
+  XCTAssertEqual(keys[1], 0x22);
+  XCTAssertEqual(keys[2], 0x0e);
+  for (size_t idx = 0; idx < 3; idx++)
+    XCTAssertEqual(modifiers[idx], 0U);
+  HKKeyMapContextDealloc(ctxt);
+}
+
+- (void)testKeystrokePlannerTieBreak {
+  /* dead state 2 costs 3 from state 3 (cost 1, option 0x24) and from state 1 (cost 2, 0x25).
+   State 3 is settled first, but the lowest flat keystroke enters state 2 */
+  hk::KeystrokeWeights weights;
+  weights.keystroke = 1;
+  weights.modifier = 1;
+  weights.dead = 0;
+  uint32_t entries[2];
+  for (int order = 0; order < 2; order++) {
+    hk::KeystrokePlanner planner(weights);
+    planner.addTransition(0, 0x23, 0, 3);
+    planner.addTransition(0, 0x21, kCGEventFlagMaskAlternate, 1);
+    if (order) {
+      planner.addTransition(1, 0x25, 0, 2);
+      planner.addTransition(3, 0x24, kCGEventFlagMaskAlternate, 2);
+    } else {
+      planner.addTransition(3, 0x24, kCGEventFlagMaskAlternate, 2);
+      planner.addTransition(1, 0x25, 0, 2);
+    }
+    planner.addOutput(2, 0x0e, 0, 0x00eb);
+    HKKeyMapContext *ctxt = new HKKeyMapContext();
+    planner.compile(ctxt);
+    entries[order] = ctxt->stats[2];
+    HKKeyMapContextDealloc(ctxt);
+  }
+  XCTAssertEqual(entries[0], entries[1], @"the plan must not depend on the transitions order");
+  XCTAssertEqual(entries[0], __HKUtilsFlatKey(0x25, 0, 1));
+}
+
+- (void)testInvalidDeadSequence {
+  HKKeyMapContext *ctxt = new HKKeyMapContext();
+  HKKeycode keys[16];
+  HKModifier modifiers[16];
+  /* dead state without keystroke */
+  ctxt->chars.try_emplace(0x00ea, __HKUtilsFlatKey(0x0e, 0, 1));
+  XCTAssertEqual(HKKeycodesForCharacterFunction(ctxt, 0x00ea, keys, modifiers, 16), 0U);
+  /* dead state entered from itself */
+  ctxt->stats.try_emplace(1, __HKUtilsFlatKey(0x21, 0, 1));
+  XCTAssertEqual(HKKeycodesForCharacterFunction(ctxt, 0x00ea, keys, modifiers, 16), 0U);
+  HKKeyMapContextDealloc(ctxt);
+}
+
+- (void)testForwardLookup {
+  HKKeyMapContext *ctxt = CreateContext();
+  XCTAssertEqual(HKCharacterForKeyCodeFunction(ctxt, 0x00, 0), 'a');
+  XCTAssertEqual(HKCharacterForKeyCodeFunction(ctxt, 0x00, kCGEventFlagMaskShift), 'A');
+  /* modifiers that does not change the output are ignored */
+  XCTAssertEqual(HKCharacterForKeyCodeFunction(ctxt, 0x00, kCGEventFlagMaskShift | kCGEventFlagMaskCommand), 'A');
+  XCTAssertEqual(HKCharacterForKeyCodeFunction(ctxt, 0x0e, kCGEventFlagMaskShift), hk::kKeyMapNilCharacter);
+  XCTAssertEqual(HKCharacterForKeyCodeFunction(ctxt, 0x7f, 0), hk::kKeyMapNilCharacter);
+  HKKeyMapContextDealloc(ctxt);
+}
+
+@end
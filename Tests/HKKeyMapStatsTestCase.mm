@@ -0,0 +1,98 @@
+/*
+ *  HKKeyMapStatsTestCase.mm
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#import "HKKeyMapStatsTestCase.h"
+
+#include "HKKeyMapContext.h"
+#include "HKKeyMapStats.h"
+
+#include <thread>
+#include <vector>
+
+@implementation HKKeyMapStatsTestCase
+
+- (void)setUp {
+  hk::KeyMapStatsReset();
+}
+
+- (void)testLookupPaths {
+#if HK_KEYMAP_STATS
+  HKKeyMapContext *ctxt = new HKKeyMapContext();
+  ctxt->map[0x00] = 'a';
+  ctxt->keys[__HKUtilsFlatKey(0x00, kCGEventFlagMaskShift, 0)] = 'A';
+
+  /* sampling depends on the thread lookups count: use a new thread */
+  size_t found = 0;
+  std::thread([ctxt, &found] {
+    for (int idx = 0; idx < 10; idx++)
+      found += HKCharacterForKeyCodeFunction(ctxt, 0x00, 0) == 'a';
+    for (int idx = 0; idx < 3; idx++)
+      found += HKCharacterForKeyCodeFunction(ctxt, 0x00, kCGEventFlagMaskShift) == 'A';
+  }).join();
+  HKKeyMapContextDealloc(ctxt);
+  XCTAssertEqual(found, 13U);
+
+  hk::KeyMapStats stats = hk::KeyMapStatsSnapshot();
+  XCTAssertEqual(stats[hk::kKeyMapProbeFastPath].count, 10U);
+  XCTAssertEqual(stats[hk::kKeyMapProbeFastPath].samples, 0U, @"fast path must not be timed");
+  XCTAssertEqual(stats[hk::kKeyMapProbeKeysTable].count, 3U);
+  XCTAssertEqual(stats[hk::kKeyMapProbeKeysTable].samples, 1U, @"lookups must be sampled");
+  XCTAssertEqual(stats[hk::kKeyMapProbeTranslate].count, 0U);
+#endif
+}
+
+- (void)testTimer {
+#if HK_KEYMAP_STATS
+  for (int idx = 0; idx < 4; idx++) {
+    HK_KEYMAP_STATS_TIME(hk::kKeyMapProbeLayoutLoad);
+  }
+  hk::KeyMapStatsRecord(hk::kKeyMapProbeLayoutCopy, 0);
+  hk::KeyMapStatsRecord(hk::kKeyMapProbeLayoutCopy, 3);
+  hk::KeyMapStatsRecord(hk::kKeyMapProbeLayoutCopy, 1000);
+  hk::KeyMapStatsRecord(hk::kKeyMapProbeLayoutCopy, 1500);
+
+  hk::KeyMapStats stats = hk::KeyMapStatsSnapshot();
+  XCTAssertEqual(stats[hk::kKeyMapProbeLayoutLoad].count, 4U);
+  XCTAssertEqual(stats[hk::kKeyMapProbeLayoutLoad].samples, 4U);
+
+  const hk::KeyMapProbeStats &copy = stats[hk::kKeyMapProbeLayoutCopy];
+  XCTAssertEqual(copy.samples, 4U);
+  XCTAssertEqual(copy.mean(), 625U);
+  XCTAssertEqual(copy.buckets[0], 1U);
+  XCTAssertEqual(copy.buckets[2], 1U);
+  XCTAssertEqual(copy.buckets[10], 1U);
+  XCTAssertEqual(copy.buckets[11], 1U);
+  XCTAssertEqual(copy.percentile(0), 0U);
+  XCTAssertEqual(copy.percentile(.5), 1024U);
+  XCTAssertEqual(copy.percentile(.99), 2048U);
+#endif
+}
+
+- (void)testThreads {
+#if HK_KEYMAP_STATS
+  HK_KEYMAP_STATS_COUNT(hk::kKeyMapProbeFastPath);
+  std::vector<std::thread> threads;
+  for (int idx = 0; idx < 4; idx++) {
+    threads.emplace_back([] {
+      for (int count = 0; count < 1000; count++)
+        HK_KEYMAP_STATS_COUNT(hk::kKeyMapProbeFastPath);
+    });
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+  /* exited threads statistics are kept */
+  XCTAssertEqual(hk::KeyMapStatsSnapshot()[hk::kKeyMapProbeFastPath].count, 4001U);
+
+  hk::KeyMapStatsReset();
+  XCTAssertEqual(hk::KeyMapStatsSnapshot()[hk::kKeyMapProbeFastPath].count, 0U);
+  HK_KEYMAP_STATS_COUNT(hk::kKeyMapProbeFastPath);
+  XCTAssertEqual(hk::KeyMapStatsSnapshot()[hk::kKeyMapProbeFastPath].count, 1U);
+#endif
+}
+
+@end
@@ -69,6 +69,42 @@
   XCTAssertTrue(kHKVirtualSpaceKey == keycode, @"'no break space' mapping does not works");
 }
 
+- (void)testSpecialKeys {
+  HKKeyMap *keymap = [HKKeyMap currentKeyMap];
+  HKKeycode keycodes[4];
+  HKModifier modifiers[4];
+  const struct { HKKeycode keycode; UniChar character; } keys[] = {
+    { kHKVirtualF1Key, kHKF1Unicode },
+    { kHKVirtualF19Key, kHKF19Unicode },
+    { kHKVirtualReturnKey, kHKReturnUnicode },
+    { kHKVirtualForwardDeleteKey, kHKForwardDeleteUnicode },
+    { kHKVirtualDownArrowKey, kHKDownArrowUnicode },
+    { kHKVirtualClearLineKey, kHKClearLineUnicode },
+  };
+  for (size_t idx = 0; idx < sizeof(keys) / sizeof(*keys); idx++) {
+    XCTAssertTrue([keymap characterForKeycode:keys[idx].keycode] == keys[idx].character, @"invalid special character for keycode %#x", keys[idx].keycode);
+    NSUInteger count = [keymap getKeycodes:keycodes modifiers:modifiers maxLength:4 forCharacter:keys[idx].character];
+    XCTAssertTrue(count == 1 && keycodes[0] == keys[idx].keycode && modifiers[0] == 0, @"invalid special keycode for character %#x", keys[idx].character);
+  }
+  XCTAssertTrue([HKKeyMap isFunctionKey:kHKVirtualF5Key], @"F5 should be a function key");
+  XCTAssertFalse([HKKeyMap isFunctionKey:kHKVirtualReturnKey], @"Return should not be a function key");
+  XCTAssertFalse([HKKeyMap isFunctionKey:kHKInvalidVirtualKeyCode], @"Invalid keycode should not be a function key");
+}
+
+- (void)testStringRepresentation {
+  NSString *str = [HKKeyMap stringRepresentationForCharacter:'a' modifiers:kCGEventFlagMaskCommand | kCGEventFlagMaskShift];
+  XCTAssertEqualObjects(str, @"\u21E7\u2318A");
+  /* second call should hit the cache */
+  XCTAssertTrue(str == [HKKeyMap stringRepresentationForCharacter:'a' modifiers:kCGEventFlagMaskCommand | kCGEventFlagMaskShift], @"string should be cached");
+  XCTAssertEqualObjects([HKKeyMap stringRepresentationForCharacter:'5' modifiers:kCGEventFlagMaskNumericPad], @"5*");
+  XCTAssertEqualObjects([HKKeyMap stringRepresentationForCharacter:kHKReturnUnicode modifiers:0], @"\u21A9");
+  XCTAssertNil([HKKeyMap stringRepresentationForCharacter:kHKNilUnichar modifiers:kCGEventFlagMaskCommand]);
+
+  NSString *speakable = [HKKeyMap speakableStringRepresentationForCharacter:'a' modifiers:kCGEventFlagMaskCommand];
+  XCTAssertTrue([speakable hasSuffix:@" + A"], @"invalid speakable string: %@", speakable);
+  XCTAssertFalse([speakable isEqualToString:str], @"speakable and symbolic strings must not share cache entries");
+}
+
 - (void)testAdvancedReverseMapping {
   HKKeyMap *keymap = [HKKeyMap currentKeyMap];
   HKKeycode keycode = [keymap keycodeForCharacter:'n' modifiers:NULL];
@@ -0,0 +1,111 @@
+/*
+ *  HKKeyMapWarmupTestCase.mm
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#import "HKKeyMapWarmupTestCase.h"
+
+#include "HKKeyMapWarmup.h"
+
+namespace {
+
+/* Fake layout: the character produced by keycode 0. 0 means invalid layout. */
+struct FakeWarmupTraits {
+  typedef UniChar Layout;
+
+  static std::atomic<int> compiled;
+  static std::atomic<int> released;
+
+  static HKKeyMapContext *Compile(UniChar layout) {
+    if (!layout)
+      return nullptr;
+    compiled++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    HKKeyMapContext *ctxt = new HKKeyMapContext();
+    ctxt->map[0] = layout;
+    __HKMapInsertIfBetter(ctxt->chars, layout, 0, 0, 0);
+    return ctxt;
+  }
+  static void Release(UniChar &layout) { released++; layout = 0; }
+  static void WorkerWillStart() {}
+};
+
+std::atomic<int> FakeWarmupTraits::compiled;
+std::atomic<int> FakeWarmupTraits::released;
+
+typedef hk::KeyMapWarmup<FakeWarmupTraits> FakeWarmup;
+
+}
+
+@implementation HKKeyMapWarmupTestCase
+
+- (void)setUp {
+  FakeWarmupTraits::compiled = 0;
+  FakeWarmupTraits::released = 0;
+}
+
+- (void)testWarmup {
+  hk::KeyMapContextRegistry registry;
+  std::vector<std::pair<std::string, UniChar>> layouts;
+  for (UniChar chr = 'a'; chr <= 'z'; chr++)
+    layouts.emplace_back(std::string("layout.") + static_cast<char>(chr), chr);
+  layouts.emplace_back("invalid", 0);
+
+  std::atomic<int> completions(0);
+  hk::WarmupStats result;
+  FakeWarmup warmup(registry);
+  warmup.start(std::move(layouts), 4, [&](const hk::WarmupStats &stats) {
+    completions++;
+    result = stats;
+  });
+  warmup.wait();
+
+  XCTAssertTrue(warmup.isComplete());
+  XCTAssertEqual(completions.load(), 1);
+  XCTAssertEqual(result.layouts, 27U);
+  XCTAssertEqual(result.compiled, 26U);
+  XCTAssertEqual(result.failed, 1U);
+  XCTAssertEqual(result.workers, 4U);
+  XCTAssertTrue(result.busy >= result.slowest);
+  XCTAssertTrue(result.slowest > 0);
+  XCTAssertEqual(FakeWarmupTraits::released.load(), 27, @"all layouts must be released");
+
+  XCTAssertEqual(registry.size(), 26U);
+  HKKeyMapContext *ctxt = registry.lookup("layout.q");
+  XCTAssertTrue(ctxt != nullptr);
+  XCTAssertEqual(HKCharacterForKeyCodeFunction(ctxt, 0, 0), 'q');
+  XCTAssertTrue(registry.lookup("invalid") == nullptr);
+}
+
+- (void)testPublishedLayoutsAreSkipped {
+  hk::KeyMapContextRegistry registry;
+  HKKeyMapContext *ctxt = FakeWarmupTraits::Compile('a');
+  XCTAssertEqual(registry.publish("layout.a", ctxt), ctxt);
+  /* publishing twice keeps the first context */
+  XCTAssertEqual(registry.publish("layout.a", FakeWarmupTraits::Compile('b')), ctxt);
+
+  FakeWarmup warmup(registry);
+  warmup.start({ { "layout.a", 'a' }, { "layout.c", 'c' } }, 0, nullptr);
+  warmup.wait();
+  hk::WarmupStats stats = warmup.stats();
+  XCTAssertEqual(stats.skipped, 1U);
+  XCTAssertEqual(stats.compiled, 1U);
+  XCTAssertTrue(stats.workers <= 2U, @"there must not be more workers than layouts");
+  XCTAssertEqual(registry.lookup("layout.a"), ctxt);
+  XCTAssertEqual(registry.size(), 2U);
+}
+
+- (void)testEmptyWarmup {
+  hk::KeyMapContextRegistry registry;
+  bool completed = false;
+  FakeWarmup warmup(registry);
+  warmup.start({}, 0, [&](const hk::WarmupStats &stats) { completed = stats.layouts == 0; });
+  warmup.wait();
+  XCTAssertTrue(completed);
+  XCTAssertTrue(warmup.isComplete());
+}
+
+@end
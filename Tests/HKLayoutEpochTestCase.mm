@@ -0,0 +1,140 @@
+/*
+ *  HKLayoutEpochTestCase.mm
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#import "HKLayoutEpochTestCase.h"
+
+#include "HKLayoutEpoch.h"
+
+#include <thread>
+
+namespace {
+
+struct FakeLayout {
+  int identifier;
+};
+
+/* Simulated change source: the selected layout, and the layout copies made by the consumers */
+struct FakeSource {
+  hk::LayoutEpoch epoch;
+  std::atomic<int> selected { 1 };
+  std::atomic<int> copies { 0 };
+  std::atomic<int> live { 0 };
+
+  /* what the selected input source notification does */
+  void select(int identifier) {
+    selected.store(identifier);
+    epoch.invalidate();
+  }
+};
+
+FakeSource *sSource = nullptr;
+
+struct FakeLayoutTraits {
+  typedef FakeLayout *Layout;
+
+  static FakeLayout *Copy() {
+    sSource->copies++;
+    sSource->live++;
+    return new FakeLayout { sSource->selected.load() };
+  }
+  static bool Equal(FakeLayout *a, FakeLayout *b) { return a->identifier == b->identifier; }
+  static void Release(FakeLayout *layout) {
+    sSource->live--;
+    delete layout;
+  }
+};
+
+typedef hk::LayoutCache<FakeLayoutTraits> FakeLayoutCache;
+
+}
+
+@implementation HKLayoutEpochTestCase
+
+- (void)setUp {
+  sSource = new FakeSource();
+}
+
+- (void)tearDown {
+  delete sSource;
+  sSource = nullptr;
+}
+
+- (void)testEpoch {
+  hk::LayoutEpoch epoch;
+  XCTAssertEqual(epoch.current(), 1U);
+  XCTAssertEqual(epoch.invalidate(), 2U);
+  XCTAssertEqual(epoch.current(), 2U);
+}
+
+- (void)testLookupsDoNotQueryLayout {
+  {
+    FakeLayoutCache cache;
+    XCTAssertTrue(cache.stale(sSource->epoch));
+    XCTAssertTrue(cache.update(sSource->epoch), @"first update must load the layout");
+    XCTAssertEqual(cache.layout()->identifier, 1);
+    for (int idx = 0; idx < 1000; idx++) {
+      XCTAssertFalse(cache.stale(sSource->epoch));
+      XCTAssertFalse(cache.update(sSource->epoch));
+    }
+    XCTAssertEqual(sSource->copies.load(), 1, @"the layout must only be queried after an invalidation");
+  }
+  XCTAssertEqual(sSource->live.load(), 0, @"the layout must be released with the cache");
+}
+
+- (void)testLayoutChange {
+  FakeLayoutCache cache;
+  cache.update(sSource->epoch);
+
+  sSource->select(2);
+  XCTAssertTrue(cache.stale(sSource->epoch));
+  XCTAssertTrue(cache.update(sSource->epoch));
+  XCTAssertEqual(cache.layout()->identifier, 2);
+  XCTAssertEqual(cache.epoch(), sSource->epoch.current());
+  XCTAssertEqual(sSource->copies.load(), 2);
+  XCTAssertEqual(sSource->live.load(), 1);
+
+  /* notification without layout change: the copy must be released */
+  sSource->select(2);
+  XCTAssertFalse(cache.update(sSource->epoch));
+  XCTAssertEqual(sSource->copies.load(), 3);
+  XCTAssertEqual(sSource->live.load(), 1, @"copy of the same layout leaked");
+
+  /* notifications received between two lookups are coalesced */
+  for (int idx = 3; idx < 10; idx++)
+    sSource->select(idx);
+  XCTAssertTrue(cache.update(sSource->epoch));
+  XCTAssertEqual(cache.layout()->identifier, 9);
+  XCTAssertEqual(sSource->copies.load(), 4);
+}
+
+- (void)testConcurrentChanges {
+  const int kChanges = 10000;
+  FakeLayoutCache cache;
+  cache.update(sSource->epoch);
+
+  std::thread source([] {
+    for (int idx = 2; idx <= kChanges; idx++)
+      sSource->select(idx);
+  });
+  /* the consumer must end up with the last selected layout, and never go back to an older one */
+  int previous = cache.layout()->identifier;
+  bool ordered = true;
+  while (cache.layout()->identifier != kChanges) {
+    if (cache.update(sSource->epoch)) {
+      ordered = ordered && cache.layout()->identifier > previous;
+      previous = cache.layout()->identifier;
+    }
+  }
+  source.join();
+  XCTAssertTrue(ordered);
+  XCTAssertFalse(cache.update(sSource->epoch));
+  XCTAssertLessThanOrEqual(sSource->copies.load(), kChanges + 1);
+  XCTAssertEqual(sSource->live.load(), 1);
+}
+
+@end
@@ -0,0 +1,141 @@
+/*
+ *  HKTrapWindowTestCase.m
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ */
+
+#import "HKTrapWindowTestCase.h"
+#import <HotKeyToolKit/HotKeyToolKit.h>
+
+@interface HKTrapWindowTestDelegate : NSObject <HKTrapWindowDelegate>
+@property(nonatomic) NSUInteger count;
+@property(nonatomic) HKTrapKeystroke keystroke;
+@end
+
+@implementation HKTrapWindowTestDelegate
+- (void)trapWindow:(HKTrapWindow *)window didCatchKeystroke:(HKTrapKeystroke)keystroke {
+  _count++;
+  _keystroke = keystroke;
+}
+@end
+
+@implementation HKTrapWindowTestCase
+
+static
+HKTrapWindow *_HKCreateTrapWindow(void) {
+  HKTrapWindow *window = [[HKTrapWindow alloc] initWithContentRect:NSMakeRect(0, 0, 100, 100)
+                                                         styleMask:NSWindowStyleMaskTitled
+                                                           backing:NSBackingStoreBuffered
+                                                             defer:YES];
+  window.releasedWhenClosed = NO;
+  window.trapping = YES;
+  return window;
+}
+
+static
+NSEvent *_HKKeyDownEvent(HKHotKey *hotkey) {
+  NSString *chr = [NSString stringWithCharacters:(const unichar[]){ hotkey.character } length:1];
+  return [NSEvent keyEventWithType:NSEventTypeKeyDown location:NSZeroPoint modifierFlags:hotkey.modifier
+                         timestamp:0 windowNumber:0 context:nil
+                        characters:chr charactersIgnoringModifiers:chr isARepeat:NO keyCode:hotkey.keycode];
+}
+
+- (void)testKeystrokeHandler {
+  HKTrapWindow *window = _HKCreateTrapWindow();
+  window.verifyHotKey = NO;
+
+  __block NSUInteger notifications = 0;
+  id observer = [[NSNotificationCenter defaultCenter] addObserverForName:kHKTrapWindowDidCatchKeyNotification object:window
+                                                                   queue:nil usingBlock:^(NSNotification *note) { notifications++; }];
+
+  __block NSUInteger count = 0;
+  __block HKTrapKeystroke caught = { 0, 0, 0 };
+  window.keystrokeHandler = ^(HKTrapKeystroke keystroke) {
+    count++;
+    caught = keystroke;
+  };
+  HKHotKey *hotkey = [[HKHotKey alloc] initWithUnichar:'y' modifier:NSEventModifierFlagOption];
+  [window sendEvent:_HKKeyDownEvent(hotkey)];
+  [window handleHotKey:hotkey];
+
+  XCTAssertEqual(count, 2U);
+  XCTAssertEqual(caught.keycode, hotkey.keycode);
+  XCTAssertEqual(caught.character, hotkey.character);
+  /* native modifiers, not the cocoa ones */
+  XCTAssertEqual(caught.modifier, hotkey.nativeModifier);
+  XCTAssertEqual(notifications, 0U, @"the notification must not be posted when the keystroke is delivered directly");
+  [[NSNotificationCenter defaultCenter] removeObserver:observer];
+}
+
+- (void)testKeystrokeDelegate {
+  HKTrapWindow *window = _HKCreateTrapWindow();
+  window.verifyHotKey = NO;
+  HKTrapWindowTestDelegate *delegate = [[HKTrapWindowTestDelegate alloc] init];
+  window.delegate = delegate;
+
+  __block NSUInteger notifications = 0;
+  id observer = [[NSNotificationCenter defaultCenter] addObserverForName:kHKTrapWindowDidCatchKeyNotification object:window
+                                                                   queue:nil usingBlock:^(NSNotification *note) { notifications++; }];
+
+  HKHotKey *hotkey = [[HKHotKey alloc] initWithUnichar:'y' modifier:NSEventModifierFlagOption];
+  [window sendEvent:_HKKeyDownEvent(hotkey)];
+  XCTAssertEqual(delegate.count, 1U);
+  XCTAssertEqual(delegate.keystroke.keycode, hotkey.keycode);
+  XCTAssertEqual(delegate.keystroke.modifier, hotkey.nativeModifier);
+  XCTAssertEqual(notifications, 0U);
+
+  /* the block takes precedence over the delegate */
+  __block NSUInteger count = 0;
+  window.keystrokeHandler = ^(HKTrapKeystroke keystroke) { count++; };
+  [window sendEvent:_HKKeyDownEvent(hotkey)];
+  XCTAssertEqual(count, 1U);
+  XCTAssertEqual(delegate.count, 1U);
+
+  window.delegate = nil;
+  [[NSNotificationCenter defaultCenter] removeObserver:observer];
+}
+
+- (void)testKeystrokeNotification {
+  HKTrapWindow *window = _HKCreateTrapWindow();
+  window.verifyHotKey = NO;
+
+  __block NSDictionary *userInfo = nil;
+  id observer = [[NSNotificationCenter defaultCenter] addObserverForName:kHKTrapWindowDidCatchKeyNotification object:window
+                                                                   queue:nil usingBlock:^(NSNotification *note) { userInfo = note.userInfo; }];
+  HKHotKey *hotkey = [[HKHotKey alloc] initWithUnichar:'y' modifier:NSEventModifierFlagOption];
+  [window sendEvent:_HKKeyDownEvent(hotkey)];
+  XCTAssertEqualObjects(userInfo[kHKEventKeyCodeKey], @(hotkey.keycode));
+  XCTAssertEqualObjects(userInfo[kHKEventCharacterKey], @(hotkey.character));
+  [[NSNotificationCenter defaultCenter] removeObserver:observer];
+}
+
+- (void)testCheckCache {
+  HKTrapWindow *window = _HKCreateTrapWindow();
+  window.verifyHotKey = YES;
+
+  __block NSUInteger count = 0;
+  window.keystrokeHandler = ^(HKTrapKeystroke keystroke) { count++; };
+
+  HKHotKey *hotkey = [[HKHotKey alloc] initWithUnichar:'y' modifier:NSEventModifierFlagOption | NSEventModifierFlagControl];
+  [window sendEvent:_HKKeyDownEvent(hotkey)];
+  [window sendEvent:_HKKeyDownEvent(hotkey)];
+  XCTAssertEqual(count, 2U, @"%@ should be available", hotkey);
+
+  /* registering a hotkey must invalidate the cached result */
+  XCTAssertTrue([hotkey setRegistred:YES], @"%@ should be registred", hotkey);
+  [window sendEvent:_HKKeyDownEvent(hotkey)];
+  XCTAssertEqual(count, 2U, @"%@ is used and should be rejected", hotkey);
+
+  XCTAssertTrue([hotkey setRegistred:NO], @"%@ should be unregistred", hotkey);
+  [window sendEvent:_HKKeyDownEvent(hotkey)];
+  XCTAssertEqual(count, 3U, @"%@ should be available again", hotkey);
+
+  /* becoming key drops the cached results (other applications may have registred hotkeys) */
+  [window becomeKeyWindow];
+  [window sendEvent:_HKKeyDownEvent(hotkey)];
+  XCTAssertEqual(count, 4U);
+}
+
+@end
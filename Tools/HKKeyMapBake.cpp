@@ -0,0 +1,199 @@
+/*
+ *  HKKeyMapBake.cpp
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ *
+ *  Compiles a set of XKB keymaps into the static tables linked in XKB builds (see HKKeyMapBaked.h),
+ *  or checks that the linked tables match a runtime compilation of the same keymaps.
+ *
+ *  Requires libxkbcommon:
+ *  c++ -std=c++17 -O2 -I Sources -I Tools Tools/HKKeyMapBake.cpp Sources/HKKeyMapBaked.cpp Sources/HKKeyMapXKB.cpp Sources/HKKeyMapContext.cpp Sources/HKKeyMapStats.cpp -lxkbcommon -o HKKeyMapBake
+ *
+ *  Usage:
+ *  HKKeyMapBake [-l locale]... -o Sources/HKKeyMapBakedLayouts.inc <name>=<keymap.xkb>...
+ *  HKKeyMapBake [-l locale]... -c <keymap.xkb>...
+ *  -l: locale of the compose table used to resolve dead keys (default: en_US.UTF-8). May be repeated:
+ *      keymaps with dead keys are baked for each locale, keymaps without dead keys once for any locale.
+ *  -c: exits with an error if a keymap is not baked for a locale, or if its baked tables differ from a runtime compilation.
+ */
+
+#include "HKKeyMapBaked.h"
+#include "HKKeyMapXKB.h"
+#include "HKToolSupport.h"
+
+#include <ctype.h>
+#include <string.h>
+
+namespace {
+
+/* 'us' -> 'Us', 'fr_en_US.UTF-8' -> 'Fr_en_US_UTF_8' */
+std::string Symbol(const std::string &name) {
+  std::string symbol(name);
+  for (char &c : symbol) {
+    if (!isalnum(static_cast<unsigned char>(c)))
+      c = '_';
+  }
+  symbol[0] = static_cast<char>(toupper(static_cast<unsigned char>(symbol[0])));
+  return symbol;
+}
+
+void WriteTable(FILE *f, const std::string &name, const char *table, const std::vector<hk::BakedEntry> &entries) {
+  if (entries.empty())
+    return;
+  fprintf(f, "const hk::BakedEntry kBaked%s%s[] = {", name.c_str(), table);
+  for (size_t idx = 0; idx < entries.size(); idx++)
+    fprintf(f, "%s{ 0x%04x, 0x%08x },", idx % 4 ? " " : "\n  ", entries[idx].key, entries[idx].value);
+  fprintf(f, "\n};\n");
+}
+
+const char *TableName(const std::string &name, const char *table, const std::vector<hk::BakedEntry> &entries, std::string &storage) {
+  if (entries.empty())
+    return "nullptr";
+  storage = "kBaked" + name + table;
+  return storage.c_str();
+}
+
+void WriteTables(FILE *f, const std::string &symbol, const hk::BakedTables &tables) {
+  WriteTable(f, symbol, "Chars", tables.chars);
+  WriteTable(f, symbol, "States", tables.states);
+  WriteTable(f, symbol, "Keys", tables.keys);
+}
+
+/* tables: symbol of the (possibly shared) entries tables */
+void WriteLayout(FILE *f, const std::string &symbol, const std::string &name, const char *locale, uint64_t hash,
+                 const std::string &tables, const hk::BakedTables &entries) {
+  std::string chars, states, keys;
+  fprintf(f, "const hk::BakedLayout kBaked%s = {\n  \"%s\", \"%s\", 0x%016llxULL,\n  {", symbol.c_str(), name.c_str(), locale, static_cast<unsigned long long>(hash));
+  for (size_t idx = 0; idx < 128; idx++)
+    fprintf(f, "%s0x%04x,", idx % 8 ? " " : "\n    ", entries.map[idx]);
+  fprintf(f, "\n  },\n  %s, %zu,\n  %s, %zu,\n  %s, %zu,\n};\n\n",
+          TableName(tables, "Chars", entries.chars, chars), entries.chars.size(),
+          TableName(tables, "States", entries.states, states), entries.states.size(),
+          TableName(tables, "Keys", entries.keys, keys), entries.keys.size());
+}
+
+/* Keymaps with dead keys are baked for each locale, sharing the tables when the compose tables give the same result */
+int Bake(const char *output, const std::vector<const char *> &locales, int argc, char **argv) {
+  std::string layouts;
+  std::string command;
+  std::string names;
+  FILE *f = fopen(output, "w");
+  if (!f) {
+    fprintf(stderr, "cannot create %s\n", output);
+    return 1;
+  }
+  for (const char *locale : locales) {
+    command.append(" -l ").append(locale);
+    names.append(names.empty() ? "" : ", ").append(locale);
+  }
+  command.append(" -o ").append(output);
+  for (int idx = 0; idx < argc; idx++)
+    command.append(" ").append(argv[idx]);
+  fprintf(f, "/*\n *  %s\n *  HotKeyToolKit\n *\n *  Generated by Tools/HKKeyMapBake. Do not edit.\n *  HKKeyMapBake%s\n */\n\n",
+          strrchr(output, '/') ? strrchr(output, '/') + 1 : output, command.c_str());
+  fprintf(f, "/* XKB keymaps (compose tables: %s). uchr layouts are not baked. */\n#if !defined(__APPLE__)\n\nnamespace {\n\n", names.c_str());
+
+  for (int idx = 0; idx < argc; idx++) {
+    const char *sep = strchr(argv[idx], '=');
+    if (!sep) {
+      fprintf(stderr, "invalid layout '%s', expected <name>=<keymap.xkb>\n", argv[idx]);
+      fclose(f);
+      return 1;
+    }
+    std::string name(argv[idx], sep - argv[idx]);
+    std::string text;
+    if (!hk::tool::ReadFile(sep + 1, text)) {
+      fprintf(stderr, "cannot read %s\n", sep + 1);
+      fclose(f);
+      return 1;
+    }
+    /* symbol -> tables already written for this keymap */
+    std::vector<std::pair<std::string, hk::BakedTables>> written;
+    for (const char *locale : locales) {
+      HKKeyMapContext *ctxt = HKKeyMapContextCreateWithXKBString(text.data(), text.size(), locale);
+      if (!ctxt) {
+        fprintf(stderr, "failed to compile %s\n", sep + 1);
+        fclose(f);
+        return 1;
+      }
+      hk::BakedTables tables = hk::BakeContext(ctxt);
+      HKKeyMapContextDealloc(ctxt);
+      /* no dead state: the compose table is not used */
+      bool any = tables.states.empty();
+      std::string symbol = Symbol(any ? name : name + "_" + locale);
+      auto shared = std::find_if(written.begin(), written.end(), [&](const auto &entry) { return hk::BakedTablesEqual(entry.second, tables); });
+      if (shared == written.end()) {
+        WriteTables(f, symbol, tables);
+        shared = written.emplace(written.end(), symbol, tables);
+      }
+      WriteLayout(f, symbol, name, any ? "" : locale, HKKeyMapXKBLayoutHash(text.data(), text.size(), any ? "" : locale), shared->first, tables);
+      layouts.append("  &kBaked").append(symbol).append(",\n");
+      printf("%s (%s): %zu characters, %zu dead states, %zu keystrokes\n", name.c_str(), any ? "any locale" : locale,
+             tables.chars.size(), tables.states.size(), tables.keys.size());
+      if (any)
+        break;
+    }
+  }
+  fprintf(f, "}\n\n#endif\n\nconst hk::BakedLayout *const hk::kBakedLayouts[] = {\n#if !defined(__APPLE__)\n%s#endif\n  nullptr,\n};\n", layouts.c_str());
+  return fclose(f) ? 1 : 0;
+}
+
+int Check(const std::vector<const char *> &locales, int argc, char **argv) {
+  int failures = 0;
+  for (int idx = 0; idx < argc; idx++) {
+    std::string text;
+    if (!hk::tool::ReadFile(argv[idx], text)) {
+      fprintf(stderr, "cannot read %s\n", argv[idx]);
+      failures++;
+      continue;
+    }
+    for (const char *locale : locales) {
+      HKKeyMapContext *baked = nullptr;
+      double lookup = hk::tool::Measure([&] { baked = HKKeyMapContextGetBakedXKB(text.data(), text.size(), locale); });
+      HKKeyMapContext *ctxt = nullptr;
+      double compile = hk::tool::Measure([&] { ctxt = HKKeyMapContextCreateWithXKBString(text.data(), text.size(), locale); });
+      if (!baked || !ctxt) {
+        printf("%s (%s): %s\n", argv[idx], locale, baked ? "compilation failed" : "not baked");
+        failures++;
+      } else if (!hk::BakedTablesEqual(hk::BakeContext(baked), hk::BakeContext(ctxt))) {
+        printf("%s (%s): baked tables differ from runtime compilation\n", argv[idx], locale);
+        failures++;
+      } else {
+        printf("%s (%s): %s matches (load: %.1f µs, compile: %.1f µs)\n", argv[idx], locale, baked->baked->name, lookup / 1e3, compile / 1e3);
+      }
+      if (ctxt)
+        HKKeyMapContextDealloc(ctxt);
+    }
+  }
+  return failures ? 1 : 0;
+}
+
+}
+
+int main(int argc, char **argv) {
+  std::vector<const char *> locales;
+  const char *output = nullptr;
+  bool check = false;
+  int idx = 1;
+  for (; idx < argc && argv[idx][0] == '-'; idx++) {
+    if (!strcmp(argv[idx], "-l") && idx + 1 < argc) {
+      locales.push_back(argv[++idx]);
+    } else if (!strcmp(argv[idx], "-o") && idx + 1 < argc) {
+      output = argv[++idx];
+    } else if (!strcmp(argv[idx], "-c")) {
+      check = true;
+    } else {
+      break;
+    }
+  }
+  if (idx >= argc || check == (output != nullptr)) {
+    fprintf(stderr, "usage: %s [-l locale]... -o <output.inc> <name>=<keymap.xkb>...\n", argv[0]);
+    fprintf(stderr, "       %s [-l locale]... -c <keymap.xkb>...\n", argv[0]);
+    return 1;
+  }
+  if (locales.empty())
+    locales.push_back("en_US.UTF-8");
+  return check ? Check(locales, argc - idx, argv + idx) : Bake(output, locales, argc - idx, argv + idx);
+}
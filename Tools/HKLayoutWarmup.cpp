@@ -0,0 +1,93 @@
+/*
+ *  HKLayoutWarmup.cpp
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ *
+ *  Compiles a set of XKB keymaps using the layouts warm-up (the same scheduler used by
+ *  +[HKKeyMap warmUpEnabledLayoutsWithCompletionHandler:] on macOS), once using a single worker
+ *  and once using the requested number of workers, and reports the warm-up statistics.
+ *
+ *  Requires libxkbcommon:
+ *  c++ -std=c++17 -O2 -I Sources -I Tools Tools/HKLayoutWarmup.cpp Sources/HKKeyMapBaked.cpp Sources/HKKeyMapXKB.cpp Sources/HKKeyMapContext.cpp Sources/HKKeyMapStats.cpp -lxkbcommon -lpthread -o HKLayoutWarmup
+ *
+ *  Usage:
+ *  HKLayoutWarmup [-j workers] [-r copies] <keymap.xkb>...
+ *  -j: number of workers (default: one per core).
+ *  -r: compiles each keymap <copies> times, as distinct layouts (default: 1).
+ */
+
+#include "HKKeyMapWarmup.h"
+#include "HKKeyMapXKB.h"
+#include "HKToolSupport.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+namespace {
+
+struct XKBWarmupTraits {
+  typedef std::string Layout;
+  /* always compiles, even if the keymap is baked */
+  static HKKeyMapContext *Compile(const std::string &path) {
+    std::string text;
+    return hk::tool::ReadFile(path.c_str(), text) ? HKKeyMapContextCreateWithXKBString(text.data(), text.size(), nullptr) : nullptr;
+  }
+  static void Release(std::string &) {}
+  /* lower the worker priority (per thread on Linux) */
+  static void WorkerWillStart() { setpriority(PRIO_PROCESS, 0, 10); }
+};
+
+hk::WarmupStats Run(const std::vector<std::pair<std::string, std::string>> &layouts, unsigned workers, size_t &published) {
+  hk::KeyMapContextRegistry registry;
+  hk::WarmupStats result;
+  hk::KeyMapWarmup<XKBWarmupTraits> warmup(registry);
+  warmup.start(layouts, workers, [&](const hk::WarmupStats &stats) { result = stats; });
+  warmup.wait();
+  published = registry.size();
+  return result;
+}
+
+void Print(const char *name, const hk::WarmupStats &stats, size_t published) {
+  printf("%-10s %2u workers: %zu/%zu compiled (%zu failed, %zu published) in %8.2f ms, compile time: %8.2f ms, slowest: %6.2f ms\n",
+         name, stats.workers, stats.compiled, stats.layouts, stats.failed, published,
+         stats.elapsed / 1e6, stats.busy / 1e6, stats.slowest / 1e6);
+}
+
+}
+
+int main(int argc, char **argv) {
+  unsigned workers = 0;
+  unsigned copies = 1;
+  int idx = 1;
+  for (; idx < argc && argv[idx][0] == '-'; idx++) {
+    if (!strcmp(argv[idx], "-j") && idx + 1 < argc) {
+      workers = static_cast<unsigned>(atoi(argv[++idx]));
+    } else if (!strcmp(argv[idx], "-r") && idx + 1 < argc) {
+      copies = static_cast<unsigned>(atoi(argv[++idx]));
+    } else {
+      break;
+    }
+  }
+  if (idx >= argc || !copies) {
+    fprintf(stderr, "usage: %s [-j workers] [-r copies] <keymap.xkb>...\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<std::pair<std::string, std::string>> layouts;
+  for (unsigned copy = 0; copy < copies; copy++) {
+    for (int arg = idx; arg < argc; arg++)
+      layouts.emplace_back(std::string(argv[arg]) + "#" + std::to_string(copy), argv[arg]);
+  }
+
+  size_t published = 0;
+  hk::WarmupStats serial = Run(layouts, 1, published);
+  Print("serial", serial, published);
+  hk::WarmupStats parallel = Run(layouts, workers, published);
+  Print("parallel", parallel, published);
+  if (parallel.elapsed)
+    printf("speedup: %.2fx\n", static_cast<double>(serial.elapsed) / parallel.elapsed);
+  return parallel.failed ? 1 : 0;
+}
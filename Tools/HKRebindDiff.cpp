@@ -0,0 +1,111 @@
+/*
+ *  HKRebindDiff.cpp
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ *
+ *  Simulates a layout change with registered hotkeys: binds hotkeys to the characters of a first
+ *  keymap, diffs the two keymaps for these hotkeys (the diff used to rebind hotkeys on macOS
+ *  when the selected layout changes), and reports the hotkeys to register again and the diff time.
+ *
+ *  Requires libxkbcommon:
+ *  c++ -std=c++17 -O2 -I Sources -I Tools Tools/HKRebindDiff.cpp Sources/HKHotKeyRebind.cpp Sources/HKKeyMapBaked.cpp Sources/HKKeyMapXKB.cpp Sources/HKKeyMapContext.cpp Sources/HKKeyMapStats.cpp -lxkbcommon -o HKRebindDiff
+ *
+ *  Usage:
+ *  HKRebindDiff [-n hotkeys] <from.xkb> <to.xkb>
+ *  -n: number of hotkeys (default: one per character and modifiers combination, up to 10000).
+ */
+
+#include "HKHotKeyRebind.h"
+#include "HKKeyMapXKB.h"
+#include "HKToolSupport.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+
+const HKModifier kHotKeyModifiers[] = {
+  kCGEventFlagMaskCommand,
+  kCGEventFlagMaskCommand | kCGEventFlagMaskShift,
+  kCGEventFlagMaskControl,
+  kCGEventFlagMaskControl | kCGEventFlagMaskAlternate,
+};
+
+/* always compiles, so the contexts tables are available */
+HKKeyMapContext *Load(const char *path) {
+  std::string text;
+  return hk::tool::ReadFile(path, text) ? HKKeyMapContextCreateWithXKBString(text.data(), text.size(), nullptr) : nullptr;
+}
+
+}
+
+int main(int argc, char **argv) {
+  size_t count = 0;
+  int idx = 1;
+  if (idx + 1 < argc && !strcmp(argv[idx], "-n")) {
+    count = static_cast<size_t>(atol(argv[idx + 1]));
+    idx += 2;
+  }
+  if (argc - idx != 2) {
+    fprintf(stderr, "usage: %s [-n hotkeys] <from.xkb> <to.xkb>\n", argv[0]);
+    return 1;
+  }
+
+  HKKeyMapContext *from = Load(argv[idx]);
+  HKKeyMapContext *to = Load(argv[idx + 1]);
+  if (!from || !to) {
+    fprintf(stderr, "failed to load keymap %s\n", from ? argv[idx + 1] : argv[idx]);
+    return 1;
+  }
+
+  /* hotkeys on printable characters, registered with the keycode resolved in the first layout */
+  std::vector<UniChar> characters;
+  for (const auto &entry : from->chars) {
+    if (entry.first > ' ' && hk::ResolveKeycode(from, entry.first) != hk::kRebindInvalidKeycode)
+      characters.push_back(entry.first);
+  }
+  std::sort(characters.begin(), characters.end());
+  if (characters.empty()) {
+    fprintf(stderr, "no character available in %s\n", argv[idx]);
+    return 1;
+  }
+  if (!count)
+    count = std::min<size_t>(characters.size() * (sizeof(kHotKeyModifiers) / sizeof(*kHotKeyModifiers)), 10000);
+
+  std::vector<hk::KeycodeBinding> bindings;
+  bindings.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    UniChar chr = characters[i % characters.size()];
+    HKModifier modifier = kHotKeyModifiers[(i / characters.size()) % (sizeof(kHotKeyModifiers) / sizeof(*kHotKeyModifiers))];
+    bindings.push_back({ chr, hk::ResolveKeycode(from, chr), modifier });
+  }
+
+  std::vector<hk::KeycodeChange> changes;
+  const int rounds = 20;
+  double elapsed = hk::tool::Measure([&] {
+    for (int round = 0; round < rounds; round++)
+      changes = hk::DiffBindings(from, to, bindings);
+  }) / rounds;
+
+  size_t unavailable = 0;
+  for (const hk::KeycodeBinding &binding : bindings) {
+    if (!hk::IsKeycodeBinding(binding) && hk::ResolveKeycode(to, binding.character) == hk::kRebindInvalidKeycode)
+      unavailable++;
+  }
+
+  printf("%zu hotkeys on %zu characters: %zu to register again (%.1f%%), %zu not available in the new layout\n",
+         bindings.size(), characters.size(), changes.size(), 100. * changes.size() / bindings.size(), unavailable);
+  printf("diff: %.3f ms (%.1f ns/hotkey)\n", elapsed / 1e6, elapsed / bindings.size());
+  for (size_t i = 0; i < changes.size() && i < 8; i++) {
+    const hk::KeycodeBinding &binding = bindings[changes[i].index];
+    printf("  U+%04X: 0x%02x -> 0x%02x\n", binding.character, binding.keycode, changes[i].keycode);
+  }
+
+  HKKeyMapContextDealloc(from);
+  HKKeyMapContextDealloc(to);
+  return 0;
+}
@@ -0,0 +1,453 @@
+/*
+ *  HKRegistryStress.cpp
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ *
+ *  Stress test of the hotkey registry (the one used by the hotkey manager on macOS) with the
+ *  platform registration stubbed: fills the registry, runs randomized register, unregister,
+ *  unregister all and dispatch operations from a growing number of threads, checks that the
+ *  registry and the stub platform agree, and reports throughput, latency and memory.
+ *  With -q, register and unregister operations are submitted to a command queue drained by a
+ *  single owner thread (as the hotkey manager does on the main thread), and the reported latency
+ *  is the submission latency.
+ *
+ *  c++ -std=c++17 -O2 -I Sources -I Tools Tools/HKRegistryStress.cpp -lpthread -o HKRegistryStress
+ *
+ *  Using ThreadSanitizer (use smaller counts, it is much slower):
+ *  c++ -std=c++17 -O1 -g -fsanitize=thread -I Sources -I Tools Tools/HKRegistryStress.cpp -lpthread -o HKRegistryStress
+ *
+ *  Usage:
+ *  HKRegistryStress [-n hotkeys] [-t threads] [-o operations] [-c clears] [-s seed] [-q]
+ *  -n: number of hotkeys (default: 10000).
+ *  -t: maximum number of threads, the mixed phase runs with 1, 2, 4, … threads up to this count (default: one per core, at least 4).
+ *  -o: operations per thread (default: 100000).
+ *  -c: unregister all operations per million operations (default: 10).
+ *  -s: random seed.
+ *  -q: queue the registration operations.
+ */
+
+#include "HKCommandQueue.h"
+#include "HKHotKeyRegistry.h"
+#include "HKToolSupport.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <random>
+#include <thread>
+#include <unordered_set>
+
+// MARK: Memory
+/* live heap bytes (each block is prefixed by its size) */
+static std::atomic<int64_t> sLiveBytes(0);
+static std::atomic<int64_t> sPeakBytes(0);
+static constexpr size_t kHeaderSize = alignof(std::max_align_t);
+
+void *operator new(size_t size) {
+  void *block = malloc(size + kHeaderSize);
+  if (!block)
+    throw std::bad_alloc();
+  *static_cast<size_t *>(block) = size;
+  int64_t live = sLiveBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed) + static_cast<int64_t>(size);
+  int64_t peak = sPeakBytes.load(std::memory_order_relaxed);
+  while (live > peak && !sPeakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+  return static_cast<char *>(block) + kHeaderSize;
+}
+void operator delete(void *ptr) noexcept {
+  if (!ptr)
+    return;
+  size_t *block = reinterpret_cast<size_t *>(reinterpret_cast<uintptr_t>(ptr) - kHeaderSize);
+  sLiveBytes.fetch_sub(static_cast<int64_t>(*block), std::memory_order_relaxed);
+  free(block);
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete[](void *ptr) noexcept { operator delete(ptr); }
+void operator delete(void *ptr, size_t) noexcept { operator delete(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { operator delete(ptr); }
+
+namespace {
+
+// MARK: Stub Platform
+struct StubHotKey {
+  uint16_t keycode;
+  uint32_t modifier;
+  std::atomic<uint64_t> presses;
+};
+
+uint64_t _Keystroke(const StubHotKey *hotkey) {
+  return (static_cast<uint64_t>(hotkey->modifier) << 16) | hotkey->keycode;
+}
+
+/* Rejects keystrokes already registered, as RegisterEventHotKey() does */
+struct StubPlatform {
+  std::mutex lock;
+  std::unordered_set<uint64_t> keystrokes;
+  bool handler = false;
+  std::atomic<uint64_t> conflicts { 0 };
+  std::atomic<uint64_t> errors { 0 };
+};
+
+StubPlatform &_Platform() {
+  static auto *sPlatform = new StubPlatform();
+  return *sPlatform;
+}
+
+struct StubRegistryTraits {
+  typedef StubHotKey *HotKey;
+  typedef uint64_t Ref;
+  typedef std::hash<StubHotKey *> Hash;
+
+  static bool Register(StubHotKey *hotkey, uint32_t uid, uint64_t *ref) {
+    StubPlatform &platform = _Platform();
+    std::lock_guard<std::mutex> lock(platform.lock);
+    if (!uid || !platform.keystrokes.insert(_Keystroke(hotkey)).second) {
+      platform.conflicts.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    *ref = _Keystroke(hotkey);
+    return true;
+  }
+
+  static bool Unregister(StubHotKey *, uint64_t ref) {
+    StubPlatform &platform = _Platform();
+    std::lock_guard<std::mutex> lock(platform.lock);
+    if (!platform.keystrokes.erase(ref)) {
+      platform.errors.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  static bool InstallHandler() {
+    StubPlatform &platform = _Platform();
+    std::lock_guard<std::mutex> lock(platform.lock);
+    if (platform.handler)
+      platform.errors.fetch_add(1, std::memory_order_relaxed);
+    platform.handler = true;
+    return true;
+  }
+
+  static void UninstallHandler() {
+    StubPlatform &platform = _Platform();
+    std::lock_guard<std::mutex> lock(platform.lock);
+    if (!platform.handler)
+      platform.errors.fetch_add(1, std::memory_order_relaxed);
+    platform.handler = false;
+  }
+};
+
+typedef hk::HotKeyRegistry<StubRegistryTraits> StubRegistry;
+
+// MARK: Operations
+enum Operation {
+  kOperationRegister,
+  kOperationUnregister,
+  kOperationUnregisterAll,
+  kOperationDispatch,
+  kOperationCount,
+};
+
+const char *const kOperationNames[] = { "register", "unregister", "unregister all", "dispatch" };
+
+struct Latencies {
+  std::vector<uint32_t> values[kOperationCount];
+
+  void merge(const Latencies &other) {
+    for (size_t op = 0; op < kOperationCount; op++)
+      values[op].insert(values[op].end(), other.values[op].begin(), other.values[op].end());
+  }
+};
+
+uint64_t _Now() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+struct Config {
+  size_t hotkeys = 10000;
+  unsigned threads = 0;
+  size_t operations = 100000;
+  uint32_t clears = 10; // per million operations
+  uint64_t seed = 0;
+  bool queued = false;
+};
+
+// MARK: Registration Queue
+struct QueuedOperation {
+  Operation op;
+  StubHotKey *hotkey;
+};
+
+/* Registry owner: executes the queued operations on its own thread */
+class Owner {
+public:
+  Owner(StubRegistry &registry) : queue([this] { __Wakeup(); }), _registry(registry) {
+    _thread = std::thread([this] { __Run(); });
+  }
+
+  ~Owner() {
+    {
+      std::lock_guard<std::mutex> lock(_lock);
+      _stop = true;
+    }
+    _cond.notify_one();
+    _thread.join();
+  }
+
+  /* Waits until all the operations submitted before the call are executed */
+  void sync() {
+    queue.submit({ kOperationCount, nullptr }).wait();
+  }
+
+  hk::CommandQueue<QueuedOperation, uint32_t> queue;
+
+private:
+  void __Wakeup() {
+    {
+      std::lock_guard<std::mutex> lock(_lock);
+      _pending = true;
+    }
+    _cond.notify_one();
+  }
+
+  void __Run() {
+    std::unique_lock<std::mutex> lock(_lock);
+    while (true) {
+      _cond.wait(lock, [this] { return _pending || _stop; });
+      if (!_pending)
+        break;
+      _pending = false;
+      lock.unlock();
+      queue.drain([this](QueuedOperation &operation) -> uint32_t {
+        switch (operation.op) {
+          case kOperationRegister:
+            return _registry.add(operation.hotkey);
+          case kOperationUnregister:
+            return _registry.remove(operation.hotkey);
+          case kOperationUnregisterAll:
+            return static_cast<uint32_t>(_registry.clear());
+          default:
+            return 0;
+        }
+      });
+      lock.lock();
+    }
+  }
+
+  StubRegistry &_registry;
+  std::thread _thread;
+  std::mutex _lock;
+  std::condition_variable _cond;
+  bool _pending = false;
+  bool _stop = false;
+};
+
+void _UpdateMaxUID(std::atomic<uint32_t> &maxUID, uint32_t uid) {
+  uint32_t max = maxUID.load(std::memory_order_relaxed);
+  while (uid > max && !maxUID.compare_exchange_weak(max, uid, std::memory_order_relaxed)) {}
+}
+
+void _Worker(StubRegistry &registry, Owner *owner, std::vector<StubHotKey> &hotkeys, std::atomic<uint32_t> &maxUID,
+             const Config &config, uint64_t seed, Latencies &latencies) {
+  std::mt19937_64 random(seed);
+  for (auto &values : latencies.values)
+    values.reserve(config.operations / 2);
+
+  for (size_t idx = 0; idx < config.operations; idx++) {
+    uint64_t draw = random() % 1000000;
+    Operation op = draw < config.clears ? kOperationUnregisterAll :
+      draw < 400000 ? kOperationRegister : draw < 700000 ? kOperationUnregister : kOperationDispatch;
+    StubHotKey *hotkey = &hotkeys[random() % hotkeys.size()];
+
+    uint64_t start = _Now();
+    if (owner && op != kOperationDispatch) {
+      if (op == kOperationRegister)
+        owner->queue.submit({ op, hotkey }, [&maxUID](const uint32_t &uid) { _UpdateMaxUID(maxUID, uid); });
+      else
+        owner->queue.submit({ op, hotkey }, nullptr);
+      latencies.values[op].push_back(static_cast<uint32_t>(std::min<uint64_t>(_Now() - start, UINT32_MAX)));
+      continue;
+    }
+    switch (op) {
+      case kOperationRegister:
+        _UpdateMaxUID(maxUID, registry.add(hotkey));
+        break;
+      case kOperationUnregister:
+        registry.remove(hotkey);
+        break;
+      case kOperationUnregisterAll:
+        registry.clear();
+        break;
+      case kOperationDispatch: {
+        uint32_t max = maxUID.load(std::memory_order_relaxed);
+        if (StubHotKey *pressed = registry.find(static_cast<uint32_t>(random() % (max + 1))))
+          pressed->presses.fetch_add(1, std::memory_order_relaxed);
+        break;
+      }
+      default:
+        break;
+    }
+    latencies.values[op].push_back(static_cast<uint32_t>(std::min<uint64_t>(_Now() - start, UINT32_MAX)));
+  }
+}
+
+/* Returns the number of inconsistencies between the registry and the platform. Must be called when no worker is running. */
+size_t _Check(const StubRegistry &registry) {
+  StubPlatform &platform = _Platform();
+  size_t errors = platform.errors.load(std::memory_order_relaxed);
+  std::vector<std::pair<uint32_t, StubHotKey *>> uids;
+  /* same lock order as the registry: registry, then platform */
+  registry.withRecords([&](const StubRegistry::Records &records) {
+    std::lock_guard<std::mutex> lock(platform.lock);
+    for (const auto &iter : records) {
+      if (iter.second.ref != _Keystroke(iter.first) || !platform.keystrokes.count(iter.second.ref))
+        errors++;
+      uids.emplace_back(iter.second.uid, iter.first);
+    }
+    if (records.size() != platform.keystrokes.size() || platform.handler != !records.empty())
+      errors++;
+  });
+  std::sort(uids.begin(), uids.end());
+  for (size_t idx = 0; idx < uids.size(); idx++) {
+    if (!uids[idx].first || (idx && uids[idx].first == uids[idx - 1].first) || registry.find(uids[idx].first) != uids[idx].second)
+      errors++;
+  }
+  return errors;
+}
+
+void _PrintLatencies(Latencies &latencies) {
+  for (size_t op = 0; op < kOperationCount; op++) {
+    std::vector<uint32_t> &values = latencies.values[op];
+    if (values.empty())
+      continue;
+    std::sort(values.begin(), values.end());
+    auto at = [&](double p) { return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))]; };
+    printf("    %-15s %9zu ops  p50: %6u ns  p99: %7u ns  p99.9: %8u ns  max: %9u ns\n",
+           kOperationNames[op], values.size(), at(.5), at(.99), at(.999), values.back());
+  }
+}
+
+}
+
+int main(int argc, char **argv) {
+  Config config;
+  config.seed = static_cast<uint64_t>(_Now());
+  for (int idx = 1; idx < argc; idx++) {
+    if (idx + 1 < argc && !strcmp(argv[idx], "-n")) {
+      config.hotkeys = static_cast<size_t>(atol(argv[++idx]));
+    } else if (idx + 1 < argc && !strcmp(argv[idx], "-t")) {
+      config.threads = static_cast<unsigned>(atoi(argv[++idx]));
+    } else if (idx + 1 < argc && !strcmp(argv[idx], "-o")) {
+      config.operations = static_cast<size_t>(atol(argv[++idx]));
+    } else if (idx + 1 < argc && !strcmp(argv[idx], "-c")) {
+      config.clears = static_cast<uint32_t>(atoi(argv[++idx]));
+    } else if (idx + 1 < argc && !strcmp(argv[idx], "-s")) {
+      config.seed = strtoull(argv[++idx], nullptr, 10);
+    } else if (!strcmp(argv[idx], "-q")) {
+      config.queued = true;
+    } else {
+      fprintf(stderr, "usage: %s [-n hotkeys] [-t threads] [-o operations] [-c clears] [-s seed] [-q]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (!config.hotkeys)
+    config.hotkeys = 1;
+  if (!config.threads)
+    config.threads = std::max(4U, std::thread::hardware_concurrency());
+  printf("%zu hotkeys, up to %u threads, %zu operations per thread%s, seed: %llu\n",
+         config.hotkeys, config.threads, config.operations, config.queued ? " (queued registration)" : "",
+         (unsigned long long)config.seed);
+
+  /* unique keystrokes, except 1% of the hotkeys that use the keystroke of the previous one */
+  std::vector<StubHotKey> hotkeys(config.hotkeys);
+  for (size_t idx = 0; idx < hotkeys.size(); idx++) {
+    size_t keystroke = idx % 100 == 99 ? idx - 1 : idx;
+    hotkeys[idx].keycode = static_cast<uint16_t>(keystroke % 128);
+    hotkeys[idx].modifier = static_cast<uint32_t>(keystroke / 128) << 16;
+  }
+
+  size_t errors = 0;
+  int64_t baseline = sLiveBytes.load();
+  StubRegistry registry;
+  std::atomic<uint32_t> maxUID(0);
+
+  /* fill */
+  double fill = hk::tool::Measure([&] {
+    for (StubHotKey &hotkey : hotkeys) {
+      uint32_t uid = registry.add(&hotkey);
+      if (uid > maxUID.load(std::memory_order_relaxed))
+        maxUID.store(uid, std::memory_order_relaxed);
+    }
+  });
+  size_t filled = registry.size();
+  int64_t memory = sLiveBytes.load() - baseline;
+  printf("fill: %zu hotkeys registered in %.2f ms (%.0f ns/hotkey), registry memory: %.2f MB (%.1f bytes/hotkey)\n",
+         filled, fill / 1e6, fill / hotkeys.size(), memory / 1048576., static_cast<double>(memory) / std::max<size_t>(filled, 1));
+  errors += _Check(registry);
+
+  /* mixed operations */
+  std::unique_ptr<Owner> owner(config.queued ? new Owner(registry) : nullptr);
+  for (unsigned threads = 1; threads <= config.threads; threads = threads < config.threads ? std::min(threads * 2, config.threads) : threads + 1) {
+    std::vector<Latencies> latencies(threads);
+    std::vector<std::thread> workers;
+    uint64_t batches = owner ? owner->queue.batches() : 0;
+    uint64_t executed = owner ? owner->queue.executed() : 0;
+    double elapsed = hk::tool::Measure([&] {
+      for (unsigned idx = 0; idx < threads; idx++)
+        workers.emplace_back(_Worker, std::ref(registry), owner.get(), std::ref(hotkeys), std::ref(maxUID), std::cref(config),
+                             config.seed + threads * 1000 + idx, std::ref(latencies[idx]));
+      for (std::thread &worker : workers)
+        worker.join();
+      if (owner)
+        owner->sync();
+    });
+    for (unsigned idx = 1; idx < threads; idx++)
+      latencies[0].merge(latencies[idx]);
+
+    size_t check = _Check(registry);
+    errors += check;
+    printf("%2u threads: %10.0f ops/s, %zu registered%s\n", threads, threads * config.operations / (elapsed / 1e9),
+           registry.size(), check ? ", INCONSISTENT" : "");
+    if (owner) {
+      /* sync() returns after the counters of its batch are updated */
+      batches = owner->queue.batches() - batches;
+      executed = owner->queue.executed() - executed;
+      printf("    %llu queued operations in %llu batches (%.1f operations/batch)\n", (unsigned long long)executed,
+             (unsigned long long)batches, static_cast<double>(executed) / std::max<uint64_t>(batches, 1));
+    }
+    _PrintLatencies(latencies[0]);
+  }
+
+  owner.reset();
+
+  /* drain */
+  for (StubHotKey &hotkey : hotkeys)
+    registry.add(&hotkey);
+  size_t registered = registry.size();
+  double clear = hk::tool::Measure([&] { registry.clear(); });
+  printf("unregister all: %zu hotkeys in %.2f ms\n", registered, clear / 1e6);
+  errors += _Check(registry);
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  uint64_t presses = 0;
+  for (const StubHotKey &hotkey : hotkeys)
+    presses += hotkey.presses.load(std::memory_order_relaxed);
+  printf("dispatched: %llu, conflicts: %llu, peak heap: %.2f MB, max rss: %ld KB\n",
+         (unsigned long long)presses, (unsigned long long)_Platform().conflicts.load(),
+         sPeakBytes.load() / 1048576., usage.ru_maxrss);
+  if (errors) {
+    printf("FAILED: %zu inconsistencies\n", errors);
+    return 1;
+  }
+  printf("OK\n");
+  return 0;
+}
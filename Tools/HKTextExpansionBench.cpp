@@ -0,0 +1,231 @@
+/*
+ *  HKTextExpansionBench.cpp
+ *  HotKeyToolKit
+ *
+ *  Text expansion throughput, from 'string in' to 'events posted'.
+ *
+ *  Runs the pipeline used by HKEventPostCharacterKeystrokes() with zero latency: special key check,
+ *  layout update check, reverse lookup (HKKeycodesForCharacterFunction) and keystroke expansion
+ *  (hk::PostKeystroke). Events are built and handed to a counting sink instead of being posted.
+ *
+ *  Each stage is measured separately over the whole corpus, then the full pipeline is measured,
+ *  with the number of events and heap allocations per character.
+ *  The update check is the layout epoch check used by HKKeyMap (HKLayoutEpoch.h), the selected layout
+ *  never changes during the run.
+ *
+ *  Requires libxkbcommon:
+ *  c++ -std=c++17 -O2 -I Sources -I Tools Tools/HKTextExpansionBench.cpp Sources/HKKeyMapBaked.cpp Sources/HKKeyMapXKB.cpp Sources/HKKeyMapContext.cpp Sources/HKKeyMapStats.cpp -lxkbcommon -o HKTextExpansionBench
+ *
+ *  Usage:
+ *  HKTextExpansionBench [-r rounds] [-l locale] <keymap.xkb> <corpus.txt> [<keymap.xkb> <corpus.txt> …]
+ *  HKTextExpansionBench Tests/Fixtures/Layouts/fr.xkb Tests/Fixtures/Corpora/fr.txt
+ */
+
+#include "HKKeyMapXKB.h"
+#include "HKKeystroke.h"
+#include "HKLayoutEpoch.h"
+#include "HKSpecialKeys.h"
+#include "HKToolSupport.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <new>
+
+// MARK: Allocations
+static std::atomic<uint64_t> sAllocations{0};
+
+void *operator new(size_t size) {
+  sAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = malloc(size ? size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  sAllocations.fetch_add(1, std::memory_order_relaxed);
+  return malloc(size ? size : 1);
+}
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept { return operator new(size, tag); }
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+
+// MARK: Pipeline
+namespace {
+
+/* What CGEventCreateKeyboardEvent() would produce */
+struct KeyboardEvent {
+  uint64_t timestamp;
+  uint32_t flags;
+  uint16_t keycode;
+  bool down;
+};
+
+/* Counts events instead of posting them */
+struct CountingSink {
+  KeyboardEvent last = {};
+  uint64_t events = 0;
+  uint64_t checksum = 0;
+
+  void operator()(uint16_t keycode, bool down) {
+    last = { events, 0, keycode, down };
+    events++;
+    checksum += keycode ^ (down ? 0x10000 : 0);
+  }
+};
+
+/* Selected layout, what TISCopyCurrentKeyboardLayoutInputSource() returns on macOS */
+HKKeyMapContext *sSelectedContext = nullptr;
+
+struct SelectedLayoutTraits {
+  typedef HKKeyMapContext *Layout;
+  static HKKeyMapContext *Copy() { return sSelectedContext; }
+  static bool Equal(HKKeyMapContext *a, HKKeyMapContext *b) { return a == b; }
+  static void Release(HKKeyMapContext *) {}
+};
+
+/* Layout change detection, as done by _HKKeyMapUpdate(): the selected layout is only queried after an invalidation */
+struct Layout {
+  HKKeyMapContext *ctxt = nullptr;
+  hk::LayoutEpoch epoch;
+  hk::LayoutCache<SelectedLayoutTraits> cache;
+
+  HKKeyMapContext *update() {
+    if (cache.stale(epoch))
+      cache.update(epoch);
+    return cache.layout();
+  }
+};
+
+/* Same as -[HKKeyMap getKeycodes:modifiers:maxLength:forCharacter:] */
+size_t GetKeycodes(Layout &layout, UniChar character, HKKeycode *keys, HKModifier *modifiers, size_t maxcount) {
+  HKKeycode keycode = hk::SpecialKeycodeForCharacter(character);
+  if (keycode != hk::kSpecialKeyInvalidKeycode) {
+    keys[0] = keycode;
+    modifiers[0] = 0;
+    return 1;
+  }
+  return HKKeycodesForCharacterFunction(layout.update(), character, keys, modifiers, maxcount);
+}
+
+/* Same as _HKEventPostCharacterKeystrokes() */
+bool PostCharacterKeystrokes(Layout &layout, CountingSink &sink, UniChar character) {
+  HKKeycode keys[8];
+  HKModifier mods[8];
+  size_t count = GetKeycodes(layout, character, keys, mods, 8);
+  for (size_t idx = 0; idx < count && idx < 8; idx++)
+    hk::PostKeystroke(sink, keys[idx], mods[idx]);
+  return count > 0;
+}
+
+struct Keystroke {
+  HKKeycode keycode;
+  HKModifier modifier;
+};
+
+void Run(const char *keymap, const char *corpus, const char *locale, int rounds) {
+  std::string text;
+  if (!hk::tool::ReadFile(corpus, text)) {
+    fprintf(stderr, "failed to read %s\n", corpus);
+    return;
+  }
+  std::vector<uint16_t> chars = hk::tool::Decode(text);
+
+  Layout layout;
+  double compile = hk::tool::Measure([&] { layout.ctxt = HKKeyMapContextCreateWithXKBFile(keymap, locale); });
+  if (!layout.ctxt) {
+    fprintf(stderr, "failed to load keymap %s\n", keymap);
+    return;
+  }
+  sSelectedContext = layout.ctxt;
+
+  const double total = static_cast<double>(chars.size()) * rounds;
+  uint64_t checksum = 0;
+
+  /* Stage 1: special key check */
+  double special = hk::tool::Measure([&] {
+    for (int round = 0; round < rounds; round++)
+      for (uint16_t chr : chars)
+        checksum += hk::SpecialKeycodeForCharacter(chr);
+  });
+
+  /* Stage 2: layout update check */
+  double update = hk::tool::Measure([&] {
+    for (int round = 0; round < rounds; round++)
+      for (size_t idx = 0; idx < chars.size(); idx++)
+        checksum += reinterpret_cast<uintptr_t>(layout.update()) & 1;
+  });
+
+  /* Stage 3: reverse lookup */
+  HKKeycode keys[8];
+  HKModifier mods[8];
+  double lookup = hk::tool::Measure([&] {
+    for (int round = 0; round < rounds; round++)
+      for (uint16_t chr : chars)
+        checksum += HKKeycodesForCharacterFunction(layout.ctxt, chr, keys, mods, 8);
+  });
+
+  /* Stage 4: event construction, on the keystrokes resolved for the corpus */
+  std::vector<Keystroke> keystrokes;
+  size_t unmapped = 0;
+  for (uint16_t chr : chars) {
+    size_t count = GetKeycodes(layout, chr, keys, mods, 8);
+    if (!count)
+      unmapped++;
+    for (size_t idx = 0; idx < count && idx < 8; idx++)
+      keystrokes.push_back({ keys[idx], mods[idx] });
+  }
+  CountingSink events;
+  double construct = hk::tool::Measure([&] {
+    for (int round = 0; round < rounds; round++)
+      for (const Keystroke &keystroke : keystrokes)
+        hk::PostKeystroke(events, keystroke.keycode, keystroke.modifier);
+  });
+
+  /* End to end */
+  CountingSink sink;
+  uint64_t allocations = sAllocations.load(std::memory_order_relaxed);
+  double pipeline = hk::tool::Measure([&] {
+    for (int round = 0; round < rounds; round++)
+      for (uint16_t chr : chars)
+        PostCharacterKeystrokes(layout, sink, chr);
+  });
+  allocations = sAllocations.load(std::memory_order_relaxed) - allocations;
+
+  printf("%s (%s)\n", corpus, keymap);
+  printf("  characters:       %zu (%zu unmapped), layout compiled in %.2f ms\n", chars.size(), unmapped, compile / 1e6);
+  printf("  special key:      %7.2f ns/char\n", special / total);
+  printf("  update check:     %7.2f ns/char\n", update / total);
+  printf("  reverse lookup:   %7.2f ns/char\n", lookup / total);
+  printf("  event building:   %7.2f ns/char\n", construct / total);
+  printf("  pipeline:         %7.2f ns/char, %.2f M chars/s\n", pipeline / total, total / pipeline * 1e3);
+  printf("  events:           %.2f per char\n", sink.events / total);
+  printf("  allocations:      %.4f per char\n", allocations / total);
+  printf("  checksum:         %016llx\n", (unsigned long long)(checksum ^ sink.checksum ^ events.checksum));
+
+  HKKeyMapContextDealloc(layout.ctxt);
+}
+
+}
+
+int main(int argc, char **argv) {
+  int rounds = 1000;
+  const char *locale = nullptr;
+  int idx = 1;
+  for (; idx + 1 < argc && argv[idx][0] == '-'; idx += 2) {
+    if (0 == strcmp(argv[idx], "-r"))
+      rounds = atoi(argv[idx + 1]);
+    else if (0 == strcmp(argv[idx], "-l"))
+      locale = argv[idx + 1];
+  }
+  if (idx + 2 > argc || (argc - idx) % 2 || rounds <= 0) {
+    fprintf(stderr, "usage: %s [-r rounds] [-l locale] <keymap.xkb> <corpus.txt> [<keymap.xkb> <corpus.txt> …]\n", argv[0]);
+    return 1;
+  }
+  for (; idx + 1 < argc; idx += 2)
+    Run(argv[idx], argv[idx + 1], locale, rounds);
+  return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ *  HKToolSupport.h
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ *
+ *  Helpers shared by the command line tools.
+ */
+
+#if !defined(HK_TOOL_SUPPORT_H__)
+#define HK_TOOL_SUPPORT_H__ 1
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace hk {
+namespace tool {
+
+/* UTF-8 -> UTF-16. Characters outside the BMP are encoded as surrogate pairs, invalid bytes are skipped. */
+inline std::vector<uint16_t> Decode(const char *utf8, size_t length) {
+  std::vector<uint16_t> chars;
+  const unsigned char *c = reinterpret_cast<const unsigned char *>(utf8);
+  const unsigned char *end = c + length;
+  while (c < end) {
+    uint32_t unicode;
+    if (*c < 0x80) {
+      unicode = *c++;
+    } else if ((*c & 0xe0) == 0xc0 && end - c >= 2) {
+      unicode = ((c[0] & 0x1f) << 6) | (c[1] & 0x3f);
+      c += 2;
+    } else if ((*c & 0xf0) == 0xe0 && end - c >= 3) {
+      unicode = ((c[0] & 0x0f) << 12) | ((c[1] & 0x3f) << 6) | (c[2] & 0x3f);
+      c += 3;
+    } else if ((*c & 0xf8) == 0xf0 && end - c >= 4) {
+      unicode = ((c[0] & 0x07) << 18) | ((c[1] & 0x3f) << 12) | ((c[2] & 0x3f) << 6) | (c[3] & 0x3f);
+      c += 4;
+    } else {
+      c++;
+      continue;
+    }
+    if (unicode > 0xffff) {
+      unicode -= 0x10000;
+      chars.push_back(static_cast<uint16_t>(0xd800 | (unicode >> 10)));
+      chars.push_back(static_cast<uint16_t>(0xdc00 | (unicode & 0x3ff)));
+    } else {
+      chars.push_back(static_cast<uint16_t>(unicode));
+    }
+  }
+  return chars;
+}
+
+inline std::vector<uint16_t> Decode(const std::string &utf8) {
+  return Decode(utf8.data(), utf8.size());
+}
+
+inline bool ReadFile(const char *path, std::string &content) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  char buffer[4096];
+  size_t length;
+  content.clear();
+  while ((length = fread(buffer, 1, sizeof(buffer), f)) > 0)
+    content.append(buffer, length);
+  bool ok = !ferror(f);
+  fclose(f);
+  return ok;
+}
+
+/* Returns the duration of fn() in nanoseconds */
+template<class Fn>
+double Measure(Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace tool
+} // namespace hk
+
+#endif /* HK_TOOL_SUPPORT_H__ */
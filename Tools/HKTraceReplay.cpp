@@ -0,0 +1,137 @@
+/*
+ *  HKTraceReplay.cpp
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ *
+ *  Replays a hotkey event trace (see HKHotKeyTraceStart()) on a virtual clock, or generates
+ *  a synthetic trace to use the dispatch and repeat logic as a load generator.
+ *
+ *  Does not depend on any macOS framework:
+ *  c++ -std=c++17 -O2 -I Sources Tools/HKTraceReplay.cpp Sources/HKEventTrace.cpp -o HKTraceReplay
+ *
+ *  Usage:
+ *  HKTraceReplay <trace> [-v]
+ *  HKTraceReplay -g <hotkeys> <presses> [-o <trace>] [-s <seed>]
+ */
+
+#include "HKEventReplay.h"
+
+#include <chrono>
+#include <random>
+
+#include <stdlib.h>
+#include <string.h>
+
+static
+void Usage(const char *tool) {
+  fprintf(stderr, "usage: %s <trace> [-v]\n", tool);
+  fprintf(stderr, "       %s -g <hotkeys> <presses> [-o <trace>] [-s <seed>]\n", tool);
+  exit(1);
+}
+
+/* Bursts of short key presses, with a few long presses that trigger repeats. */
+static
+hk::Trace Generate(uint32_t hotkeys, uint64_t presses, uint32_t seed) {
+  hk::Trace trace;
+  std::mt19937_64 rng(seed);
+  for (uint32_t uid = 1; uid <= hotkeys; uid++) {
+    hk::TraceHotKey desc = { uid, 0, 0, 0 };
+    switch (rng() % 4) {
+      case 0:
+        desc.flags = hk::kTraceHotKeyInvokeOnKeyUp;
+        break;
+      case 1:
+        desc.initialRepeatInterval = 250000 + rng() % 500000;
+        desc.repeatInterval = 15000 + rng() % 100000;
+        break;
+      default:
+        break;
+    }
+    trace.hotkeys.push_back(desc);
+  }
+
+  std::exponential_distribution<double> gap(1. / 20); // ms
+  uint64_t time = 0;
+  uint16_t epoch = 1;
+  trace.records.reserve(presses * 2);
+  for (uint64_t idx = 0; idx < presses; idx++) {
+    /* pause between bursts */
+    time += static_cast<uint64_t>((idx % 64 == 0 ? 500 : gap(rng)) * 1e6);
+    if (rng() % 10000 == 0)
+      epoch++;
+    uint32_t uid = 1 + static_cast<uint32_t>(rng() % hotkeys);
+    uint64_t hold = (rng() % 16 == 0 ? 300 + rng() % 2000 : 30 + rng() % 100) * 1000000;
+    trace.records.push_back({ time, uid, hk::kTraceKindPressed, 0, epoch });
+    trace.records.push_back({ time + hold, uid, hk::kTraceKindReleased, 0, epoch });
+  }
+  std::stable_sort(trace.records.begin(), trace.records.end(), [](const hk::TraceRecord &lhs, const hk::TraceRecord &rhs) {
+    return lhs.time < rhs.time;
+  });
+  return trace;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2)
+    Usage(argv[0]);
+
+  hk::Trace trace;
+  bool verbose = false;
+  if (0 == strcmp(argv[1], "-g")) {
+    if (argc < 4)
+      Usage(argv[0]);
+    uint32_t hotkeys = static_cast<uint32_t>(strtoul(argv[2], nullptr, 10));
+    uint64_t presses = strtoull(argv[3], nullptr, 10);
+    const char *output = nullptr;
+    uint32_t seed = 42;
+    for (int idx = 4; idx + 1 < argc; idx += 2) {
+      if (0 == strcmp(argv[idx], "-o"))
+        output = argv[idx + 1];
+      else if (0 == strcmp(argv[idx], "-s"))
+        seed = static_cast<uint32_t>(strtoul(argv[idx + 1], nullptr, 10));
+      else
+        Usage(argv[0]);
+    }
+    if (!hotkeys)
+      Usage(argv[0]);
+    trace = Generate(hotkeys, presses, seed);
+    if (output) {
+      FILE *f = fopen(output, "wb");
+      if (!f || !hk::TraceWrite(trace, f)) {
+        fprintf(stderr, "failed to write %s\n", output);
+        return 1;
+      }
+      fclose(f);
+    }
+  } else {
+    FILE *f = fopen(argv[1], "rb");
+    if (!f || !hk::TraceRead(trace, f)) {
+      fprintf(stderr, "failed to read %s\n", argv[1]);
+      return 1;
+    }
+    fclose(f);
+    verbose = argc > 2 && 0 == strcmp(argv[2], "-v");
+  }
+
+  uint64_t checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  hk::ReplayStats stats = hk::TraceReplay(trace, [&](uint32_t hotkey, uint64_t time, bool repeat) {
+    checksum += hotkey ^ time;
+    if (verbose)
+      printf("%12.6f %s hotkey %u\n", time / 1e9, repeat ? "repeat " : "invoke ", hotkey);
+  });
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  printf("hotkeys:         %zu\n", trace.hotkeys.size());
+  printf("records:         %zu\n", trace.records.size());
+  printf("events:          %llu (%llu unknown)\n", (unsigned long long)stats.events, (unsigned long long)stats.unknown);
+  printf("invocations:     %llu\n", (unsigned long long)stats.invocations);
+  printf("repeats:         %llu (%llu recorded)\n", (unsigned long long)stats.repeats, (unsigned long long)stats.recordedRepeats);
+  printf("layout changes:  %llu\n", (unsigned long long)stats.layoutChanges);
+  printf("virtual time:    %.3f s\n", stats.duration / 1e9);
+  printf("replay time:     %.3f s (x%.0f)\n", elapsed.count(), elapsed.count() > 0 ? stats.duration / 1e9 / elapsed.count() : 0.);
+  printf("throughput:      %.0f invocations/s\n", elapsed.count() > 0 ? stats.invocations / elapsed.count() : 0.);
+  printf("checksum:        %016llx\n", (unsigned long long)checksum);
+  return 0;
+}
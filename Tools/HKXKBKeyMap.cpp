@@ -0,0 +1,94 @@
+/*
+ *  HKXKBKeyMap.cpp
+ *  HotKeyToolKit
+ *
+ *  Created by Jean-Daniel Dupas.
+ *  Copyright © 2024 Jean-Daniel Dupas. All rights reserved.
+ *
+ *  Compiles a XKB keymap into a keymap context, prints the keystrokes required to type a text,
+ *  and measures the context lookup functions and the lookup paths they take.
+ *
+ *  Requires libxkbcommon:
+ *  c++ -std=c++17 -O2 -I Sources -I Tools Tools/HKXKBKeyMap.cpp Sources/HKKeyMapBaked.cpp Sources/HKKeyMapXKB.cpp Sources/HKKeyMapContext.cpp Sources/HKKeyMapStats.cpp -lxkbcommon -o HKXKBKeyMap
+ *
+ *  A keymap file can be generated from the system layouts using xkbcomp:
+ *  setxkbmap -print -layout fr | xkbcomp -xkb - fr.xkb
+ *
+ *  Usage:
+ *  HKXKBKeyMap <keymap.xkb> [text]
+ */
+
+#include "HKKeyMapStats.h"
+#include "HKKeyMapXKB.h"
+#include "HKToolSupport.h"
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <keymap.xkb> [text]\n", argv[0]);
+    return 1;
+  }
+
+  HKKeyMapContext *ctxt = nullptr;
+  double compile = hk::tool::Measure([&] { ctxt = HKKeyMapContextCreateWithXKBFile(argv[1], nullptr); });
+  if (!ctxt) {
+    fprintf(stderr, "failed to load keymap %s\n", argv[1]);
+    return 1;
+  }
+  printf("compiled in %.3f ms: %zu characters, %zu dead states\n", compile / 1e6, ctxt->chars.size(), ctxt->stats.size());
+
+  HKKeycode keys[8];
+  HKModifier modifiers[8];
+  if (argc > 2) {
+    for (UniChar chr : hk::tool::Decode(argv[2])) {
+      size_t count = HKKeycodesForCharacterFunction(ctxt, chr, keys, modifiers, 8);
+      printf("U+%04X:", chr);
+      if (!count)
+        printf(" not found");
+      for (size_t idx = 0; idx < count && idx < 8; idx++)
+        printf(" [keycode: 0x%02x modifiers: 0x%06x]", keys[idx], modifiers[idx]);
+      printf("\n");
+    }
+  }
+
+  enum { kRounds = 1000 };
+  std::vector<UniChar> chars;
+  for (const auto &entry : ctxt->chars)
+    chars.push_back(entry.first);
+
+  uint64_t checksum = 0;
+  double reverse = hk::tool::Measure([&] {
+    for (int round = 0; round < kRounds; round++)
+      for (UniChar chr : chars)
+        checksum += HKKeycodesForCharacterFunction(ctxt, chr, keys, modifiers, 8);
+  });
+  double forward = hk::tool::Measure([&] {
+    for (int round = 0; round < kRounds; round++)
+      for (HKKeycode keycode = 0; keycode < 128; keycode++)
+        checksum += HKCharacterForKeyCodeFunction(ctxt, keycode, 0);
+  });
+  double modified = hk::tool::Measure([&] {
+    for (int round = 0; round < kRounds; round++)
+      for (HKKeycode keycode = 0; keycode < 128; keycode++)
+        checksum += HKCharacterForKeyCodeFunction(ctxt, keycode, kCGEventFlagMaskShift);
+  });
+  printf("character -> keycodes:         %.1f ns\n", reverse / (kRounds * chars.size()));
+  printf("keycode -> character:          %.1f ns\n", forward / (kRounds * 128));
+  printf("keycode + shift -> character:  %.1f ns\n", modified / (kRounds * 128));
+  printf("checksum: %llu\n", (unsigned long long)checksum);
+
+  /* lookup paths taken by the measures (build with -DHK_KEYMAP_STATS=0 to measure without instrumentation) */
+  hk::KeyMapStats stats = hk::KeyMapStatsSnapshot();
+  for (size_t idx = 0; idx < hk::kKeyMapProbeCount; idx++) {
+    const hk::KeyMapProbeStats &probe = stats.probes[idx];
+    if (!probe.count)
+      continue;
+    printf("%-12s %10llu lookups", hk::KeyMapProbeName(static_cast<hk::KeyMapProbe>(idx)), (unsigned long long)probe.count);
+    if (probe.samples)
+      printf(", mean: %llu ns, p50: %llu ns, p99: %llu ns", (unsigned long long)probe.mean(),
+             (unsigned long long)probe.percentile(.5), (unsigned long long)probe.percentile(.99));
+    printf("\n");
+  }
+
+  HKKeyMapContextDealloc(ctxt);
+  return 0;
+}